@@ -2,9 +2,13 @@
 #  -*- coding: UTF-8 -*-
 
 
-import os, sys
+import os, sys, time, subprocess
+from multiprocessing.pool import ThreadPool
 import essentia.standard as estd
 from templates import *
+import keycache
+import keysinks
+from framewise import silent_frame, frame_counts_report, accumulate_pcp
 
 # ======================= #
 # KEY ESTIMATION SETTINGS #
@@ -14,14 +18,21 @@ from templates import *
 # -------------
 SAMPLE_RATE                  = 44100
 VALID_FILE_TYPES             = {'.wav', '.mp3', 'flac', '.aiff', '.ogg'}
+BATCH_OUTPUT                 = 'jsonl'   # results file of batch runs {'jsonl', 'csv', 'bin'}, 'txt' for one file per track
 
 # Analysis Parameters
 # -------------------
 HIGHPASS_CUTOFF              = 200
+SILENCE_THRESHOLD_DB         = -70       # skip frames with a lower energy (dB relative to full scale), None to disable
 SPECTRAL_WHITENING           = True
+HPSS                         = False     # keep only the harmonic part of the spectrum (HarmonicPercussiveSeparation)
+HPSS_TIME_FRAMES             = 9         # frames of the harmonic median filter, if HPSS
+HPSS_FREQUENCY_BINS          = 17        # bins of the percussive median filter (odd), if HPSS
+HPSS_MIN_HARMONIC_RATIO      = 0.02      # skip frames with less harmonic energy than this, if HPSS
 DETUNING_CORRECTION          = True
 DETUNING_CORRECTION_SCOPE    = 'average'  # {'average', 'frame'}
 PCP_THRESHOLD                = 0.2
+FRAME_WEIGHTING              = 'none'    # weight frames by their tonal salience when summing them {'none', 'peakiness', 'entropy'}
 WINDOW_SIZE                  = 4096
 HOP_SIZE                     = 4096
 WINDOW_SHAPE                 = 'hann'
@@ -40,11 +51,39 @@ HPCP_SIZE                    = 12
 HPCP_WEIGHT_WINDOW_SEMITONES = 1         # semitones
 HPCP_WEIGHT_TYPE             = 'cosine'  # {'none', 'cosine', 'squaredCosine'}
 
+# Coarse-to-Fine Analysis
+# -----------------------
+COARSE_TO_FINE               = False     # analyse with 12 bins, re-analyse with FINE_HPCP_SIZE only if needed
+FINE_HPCP_SIZE               = 36        # {36, 120}
+ESCALATE_DETUNING_CENTS      = 15        # re-analyse tracks detuned by more than this
+ESCALATE_MARGIN              = 0.1       # re-analyse tracks with a lower first to second key ratio
+ESCALATE_PROBABILITY         = None      # re-analyse tracks with a lower key probability instead, None to use ESCALATE_MARGIN
+
+# Fast Mode
+# ---------
+FAST_MODE                    = False     # estimate the key from a few short excerpts only, for previews and triage
+FAST_EXCERPTS                = 8         # excerpts spread evenly across the track, if FAST_MODE
+FAST_EXCERPT_SECONDS         = 3         # length of each excerpt, if FAST_MODE
+FFMPEG                       = 'ffmpeg'  # decoder that seeks to the excerpts, None to decode whole files in fast mode
+
+# Chroma Archive
+# --------------
+CHROMA_ARCHIVE_DIR           = None      # dir to store 8-bit per-frame chroma (.chroma), None to disable
+
+# Result Cache
+# ------------
+RESULT_CACHE                 = None      # sqlite file with the results of previous analyses, None to disable
+
 # Key Detector Method
 # -------------------
 KEY_PROFILE                  = 'bgate'  # {'bgate', 'braw', 'edma', 'edmm'}
 USE_THREE_PROFILES           = True
 WITH_MODAL_DETAILS           = True
+KEY_TEMPERATURE              = 0.05      # softmax temperature of the key probability, see templates.fit_key_temperature
+
+
+# Frames analysed and skipped since the start, by cause
+FRAME_COUNTS = {'frames': 0, 'silent': 0, 'percussive': 0}
 
 
 def normalize_pcp_peak(pcp):
@@ -85,11 +124,126 @@ def shift_pcp(pcp, pcp_size=12):
     if max_val_index > (tuning_resolution / 2):
         shift_distance = tuning_resolution - max_val_index
     else:
-        shift_distance = max_val_index
+        shift_distance = -max_val_index
     pcp = np.roll(pcp, shift_distance)
     return pcp
 
 
+def fold_pcp(pcp):
+    """
+    Folds a pcp tuned to its tempered bins (see shift_pcp)
+    into 12 bins, adding each bin to the nearest semitone.
+    :type pcp: np.ndarray
+    """
+    tuning_resolution = pcp.size // 12
+    if tuning_resolution == 1:
+        return pcp
+    pcp = np.roll(pcp, tuning_resolution // 2)
+    return np.sum(pcp.reshape(12, tuning_resolution), axis=1)
+
+
+_pcp_postprocessing = {}
+
+
+def postprocess_pcp(pcp, normalize, threshold, detuning_correction, reference_shift=0):
+    """
+    Normalizes a pcp to a maximum of 1, zeroes the bins under threshold
+    (a fraction of the maximum), shifts it to the nearest tempered bin
+    and rotates it by reference_shift semitones, in a single pass of
+    PcpPostProcessing. Falls back to the numpy helpers above with
+    Essentia builds that lack the algorithm.
+    :type pcp: np.ndarray
+    :type normalize: bool
+    :type threshold: float (0 to disable)
+    :type detuning_correction: bool
+    :type reference_shift: int
+    """
+    if hasattr(estd, 'PcpPostProcessing'):
+        settings = (normalize, threshold, detuning_correction, reference_shift)
+        if settings not in _pcp_postprocessing:
+            _pcp_postprocessing[settings] = estd.PcpPostProcessing(normalize=normalize,
+                                                                   threshold=threshold,
+                                                                   detuningCorrection=detuning_correction,
+                                                                   referenceShift=reference_shift)
+        return _pcp_postprocessing[settings](np.asarray(pcp, dtype='float32'))
+    pcp_size = len(pcp)
+    if normalize:
+        pcp = normalize_pcp_peak(pcp)
+    if threshold:
+        pcp = pcp_gate(pcp, threshold * np.max(pcp))
+    if detuning_correction:
+        pcp = shift_pcp(pcp, pcp_size)
+    return np.roll(pcp, reference_shift * (pcp_size // 12))
+
+
+def peaks_tuning(frequencies, magnitudes):
+    """
+    Magnitude weighted sum of the deviations of spectral peaks
+    from the tempered pitches, as a phasor with one turn per semitone.
+    The phasors of all the frames can be added up, and converted
+    to cents with tuning_cents.
+    :type frequencies: np.ndarray
+    :type magnitudes: np.ndarray
+    """
+    if len(frequencies) == 0:
+        return 0j
+    semitones = 12 * np.log2(frequencies / HPCP_REFERENCE_HZ)
+    return np.sum(magnitudes * np.exp(2j * np.pi * semitones))
+
+
+def tuning_cents(phasor):
+    """
+    Converts an accumulated tuning phasor to cents in [-50, 50].
+    """
+    return 100 * np.angle(phasor) / (2 * np.pi)
+
+
+def quantize_chroma(chroma):
+    """
+    Quantizes a chromagram (frames x bins) to 8 bits per bin with a
+    single scale for the whole track, so that chroma ~= bins * scale.
+    Returns the uint8 bins and the scale.
+    :type chroma: np.ndarray
+    """
+    scale = np.float32(max(np.max(chroma), 0) / 255.0) if chroma.size else np.float32(0)
+    bins = np.clip(np.round(chroma / (scale if scale > 0 else 1)), 0, 255).astype('uint8')
+    return bins, scale
+
+
+def write_chroma_archive(filename, chroma):
+    """
+    Writes a chromagram as an 8-bit chroma archive, the format
+    read by the C++ tools (see pcpQuantization.h).
+    :type filename: str
+    :type chroma: np.ndarray
+    """
+    bins, scale = quantize_chroma(chroma)
+    with open(filename, 'wb') as archive:
+        archive.write(b'EDMC')
+        np.array([2, bins.shape[0], bins.shape[1]], dtype='<u4').tofile(archive)
+        np.array([scale], dtype='<f4').tofile(archive)
+        bins.tofile(archive)
+
+
+def read_chroma_archive(filename):
+    """
+    Reads an 8-bit chroma archive back into a float32 chromagram.
+    Version 1 archives have a scale per frame instead of one per track.
+    :type filename: str
+    """
+    with open(filename, 'rb') as archive:
+        if archive.read(4) != b'EDMC':
+            raise IOError("{0} is not a chroma archive".format(filename))
+        version, n_frames, n_bins = np.fromfile(archive, dtype='<u4', count=3)
+        if version not in (1, 2):
+            raise IOError("Unsupported chroma archive version {0}".format(version))
+        scales = np.fromfile(archive, dtype='<f4', count=n_frames if version == 1 else 1)
+        bins = np.fromfile(archive, dtype='uint8', count=n_frames * n_bins)
+    if version == 1:
+        return bins.reshape(n_frames, n_bins) * scales[:, np.newaxis]
+    return bins.reshape(n_frames, n_bins) * scales[0]
+
+
 def results_directory(out_dir):
     """
     creates a sub-folder in the specified directory
@@ -105,20 +259,33 @@ def results_directory(out_dir):
     return out_dir
 
 
-def estimate_key(input_audio_file, output_text_file):
+def key_chain(hpcp_size=HPCP_SIZE):
     """
-    This function estimates the overall key of an audio track
-    optionaly with extra modal information.
-    :type input_audio_file: str
-    :type output_text_file: str
+    Creates the algorithms of the key extraction chain,
+    which can be reused to analyse any number of tracks.
+    :type hpcp_size: int
     """
-    loader = estd.MonoLoader(filename=input_audio_file,
-                             sampleRate=SAMPLE_RATE)
+    hpf = None
+    if HIGHPASS_CUTOFF is not None:
+        hpf = estd.HighPass(cutoffFrequency=HIGHPASS_CUTOFF, sampleRate=SAMPLE_RATE)
     cut = estd.FrameCutter(frameSize=WINDOW_SIZE,
                            hopSize=HOP_SIZE)
     window = estd.Windowing(size=WINDOW_SIZE,
                             type=WINDOW_SHAPE)
     rfft = estd.Spectrum(size=WINDOW_SIZE)
+    frame_spectrum = None
+    if hasattr(estd, 'FrameSpectrum'):
+        # the excerpts of fast mode are framed and transformed at once
+        frame_spectrum = estd.FrameSpectrum(frameSize=WINDOW_SIZE,
+                                            hopSize=HOP_SIZE,
+                                            startFromZero=True,
+                                            type=WINDOW_SHAPE)
+    hpss = None
+    if HPSS:
+        hpss = estd.HarmonicPercussiveSeparation(maxFrequency=MAX_HZ,
+                                                 sampleRate=SAMPLE_RATE,
+                                                 timeFrames=HPSS_TIME_FRAMES,
+                                                 frequencyBins=HPSS_FREQUENCY_BINS)
     sw = estd.SpectralWhitening(maxFrequency=MAX_HZ,
                                 sampleRate=SAMPLE_RATE)
     speaks = estd.SpectralPeaks(magnitudeThreshold=SPECTRAL_PEAKS_THRESHOLD,
@@ -135,42 +302,258 @@ def estimate_key(input_audio_file, output_text_file):
                      normalized=HPCP_NORMALIZE,
                      referenceFrequency=HPCP_REFERENCE_HZ,
                      sampleRate=SAMPLE_RATE,
-                     size=HPCP_SIZE,
+                     size=hpcp_size,
                      weightType=HPCP_WEIGHT_TYPE,
                      windowSize=HPCP_WEIGHT_WINDOW_SEMITONES,
                      maxShifted=HPCP_SHIFT)
-    if HIGHPASS_CUTOFF is not None:
-        hpf = estd.HighPass(cutoffFrequency=HIGHPASS_CUTOFF, sampleRate=SAMPLE_RATE)
-        audio = hpf(hpf(hpf(loader())))
-    else:
-        audio = loader()
+    return hpf, cut, window, rfft, frame_spectrum, hpss, sw, speaks, hpcp, hpcp_size
+
+
+def load_audio(input_audio_file):
+    """
+    Loads an audio file as a mono signal at SAMPLE_RATE.
+    :type input_audio_file: str
+    """
+    loader = estd.MonoLoader(filename=input_audio_file,
+                             sampleRate=SAMPLE_RATE)
+    return loader()
+
+
+def audio_chroma(audio, chain, with_tuning=False):
+    """
+    Computes the frame-wise pcps (frames x hpcp size) of a mono signal,
+    and optionally its deviation from HPCP_REFERENCE_HZ in cents,
+    estimated from the spectral peaks.
+    :type audio: np.ndarray
+    :type chain: tuple (as returned by key_chain)
+    :type with_tuning: bool
+    """
+    hpf, cut, window, rfft, frame_spectrum, hpss, sw, speaks, hpcp, hpcp_size = chain
+    # the filter, the frame cutter and the separation keep state from the previous track
+    cut.reset()
+    if hpss is not None:
+        hpss.reset()
+    if hpf is not None:
+        hpf.reset()
+        audio = hpf(hpf(hpf(audio)))
     duration = len(audio)
     n_slices = 1 + (duration / HOP_SIZE)
-    chroma = np.empty([n_slices, HPCP_SIZE], dtype='float64')
+    chroma = np.zeros([n_slices, hpcp_size], dtype='float32')
+    tuning = 0j
+    FRAME_COUNTS['frames'] += n_slices
     for slice_n in range(n_slices):
-        spek = rfft(window(cut(audio)))
+        frame = cut(audio)
+        if silent_frame(frame, SILENCE_THRESHOLD_DB):
+            FRAME_COUNTS['silent'] += 1
+            continue  # left empty
+        spek = rfft(window(frame))
+        if hpss is not None:
+            spek, harmonic_ratio = hpss(spek)
+            if harmonic_ratio < HPSS_MIN_HARMONIC_RATIO:
+                FRAME_COUNTS['percussive'] += 1
+                continue  # percussive frame, left empty
         p1, p2 = speaks(spek)
+        if with_tuning:
+            tuning += peaks_tuning(p1, p2)
         if SPECTRAL_WHITENING:
             p2 = sw(spek, p1, p2)
         pcp = hpcp(p1, p2)
         if not DETUNING_CORRECTION or DETUNING_CORRECTION_SCOPE == 'average':
             chroma[slice_n] = pcp
         elif DETUNING_CORRECTION and DETUNING_CORRECTION_SCOPE == 'frame':
-            pcp = shift_pcp(pcp, HPCP_SIZE)
-            chroma[slice_n] = pcp
+            chroma[slice_n] = postprocess_pcp(pcp, True, 0, True)
         else:
             raise NameError("SHIFT_SCOPE must be set to 'frame' or 'average'.")
-    chroma = np.sum(chroma, axis=0)
-    if PCP_THRESHOLD is not None:
-        chroma = normalize_pcp_peak(chroma)
-        chroma = pcp_gate(chroma, PCP_THRESHOLD)
-    if DETUNING_CORRECTION and DETUNING_CORRECTION_SCOPE == 'average':
-        chroma = shift_pcp(chroma, HPCP_SIZE)
-    chroma = np.roll(chroma, -3)  # Adjust to essentia's HPCP calculation starting on A...
-    if USE_THREE_PROFILES:
-        estimation_1 = template_matching_3(chroma, KEY_PROFILE)
+    if with_tuning:
+        return chroma, tuning_cents(tuning)
+    return chroma
+
+
+def excerpt_starts(duration, n_excerpts, length):
+    """
+    Returns the starts of n_excerpts excerpts of a given length, centred at
+    evenly spread positions of a signal of a given duration (both in
+    samples), None if the signal is too short to hold them without
+    overlapping.
+    :type duration: int
+    :type n_excerpts: int
+    :type length: int
+    """
+    if duration <= n_excerpts * length:
+        return None
+    starts = []
+    for excerpt_n in range(n_excerpts):
+        centre = int((excerpt_n + 0.5) * duration / n_excerpts)
+        starts.append(min(max(centre - length // 2, 0), duration - length))
+    return starts
+
+
+def audio_excerpts(audio, n_excerpts, excerpt_seconds):
+    """
+    Returns n_excerpts excerpts of excerpt_seconds from a mono signal
+    (see excerpt_starts). Signals too short to hold them are returned whole.
+    :type audio: np.ndarray
+    :type n_excerpts: int
+    :type excerpt_seconds: float
+    """
+    length = int(excerpt_seconds * SAMPLE_RATE)
+    starts = excerpt_starts(len(audio), n_excerpts, length)
+    if starts is None:
+        return [audio]
+    return [audio[start:start + length] for start in starts]
+
+
+def audio_duration(input_audio_file):
+    """
+    Returns the duration of an audio file in secs, read from its
+    metadata without decoding it, 0 if unknown.
+    :type input_audio_file: str
+    """
+    reader = estd.MetadataReader(filename=input_audio_file, failOnError=False)
+    return dict(zip(reader.outputNames(), reader()))['duration']
+
+
+def decode_excerpt(input_audio_file, start, seconds):
+    """
+    Decodes an excerpt of an audio file as a mono signal at SAMPLE_RATE,
+    with FFMPEG seeking to its start instead of decoding the file from
+    the beginning.
+    :type input_audio_file: str
+    :type start: float (secs)
+    :type seconds: float
+    """
+    command = [FFMPEG, '-v', 'error', '-nostdin', '-ss', '{0:.3f}'.format(start), '-t', '{0:.3f}'.format(seconds),
+               '-i', input_audio_file, '-f', 'f32le', '-ac', '1', '-ar', str(SAMPLE_RATE), '-']
+    decoder = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    samples, error = decoder.communicate()
+    if decoder.returncode != 0:
+        raise IOError("Could not decode {0}: {1}".format(input_audio_file, error.decode('utf-8', 'replace').strip()))
+    return np.frombuffer(samples, dtype='<f4').astype('float32')
+
+
+_decoder_pool = None
+
+
+def file_excerpts(input_audio_file, n_excerpts=FAST_EXCERPTS, excerpt_seconds=FAST_EXCERPT_SECONDS):
+    """
+    Returns the excerpts of an audio file analysed by fast mode (see
+    audio_excerpts), decoding only them. FFMPEG seeks to each excerpt,
+    and the excerpts are decoded at once by a pool of threads. Files are
+    decoded whole if FFMPEG is None or fails, or if their duration is unknown.
+    :type input_audio_file: str
+    :type n_excerpts: int
+    :type excerpt_seconds: float
+    """
+    global _decoder_pool
+    length = int(excerpt_seconds * SAMPLE_RATE)
+    starts = None
+    if FFMPEG is not None:
+        starts = excerpt_starts(int(audio_duration(input_audio_file) * SAMPLE_RATE), n_excerpts, length)
+    if starts is None:
+        return audio_excerpts(load_audio(input_audio_file), n_excerpts, excerpt_seconds)
+    if _decoder_pool is None:
+        _decoder_pool = ThreadPool(FAST_EXCERPTS)
+    try:
+        return _decoder_pool.map(lambda start: decode_excerpt(input_audio_file, float(start) / SAMPLE_RATE,
+                                                              excerpt_seconds), starts)
+    except (OSError, IOError):
+        # no decoder, or one that cannot seek in this file
+        return audio_excerpts(load_audio(input_audio_file), n_excerpts, excerpt_seconds)
+
+
+def excerpts_chroma(excerpts, chain):
+    """
+    Computes the frame-wise pcps (frames x hpcp size) of a few short
+    excerpts of a track (see audio_excerpts and file_excerpts), instead of
+    the whole of it. The frames of each excerpt are windowed and
+    transformed at once with FrameSpectrum, if Essentia has it. There is
+    no silence gate, as the frames are not cut one by one.
+    :type excerpts: list of np.ndarray
+    :type chain: tuple (as returned by key_chain)
+    """
+    hpf, cut, window, rfft, frame_spectrum, hpss, sw, speaks, hpcp, hpcp_size = chain
+    chroma = []
+    for excerpt in excerpts:
+        # every excerpt is filtered and separated on its own
+        if hpss is not None:
+            hpss.reset()
+        if hpf is not None:
+            hpf.reset()
+            excerpt = hpf(hpf(hpf(excerpt)))
+        if frame_spectrum is not None:
+            spectra = frame_spectrum(excerpt)
+        else:
+            spectra = []
+            cut.reset()
+            frame = cut(excerpt)
+            while len(frame):
+                spectra.append(rfft(window(frame)))
+                frame = cut(excerpt)
+        FRAME_COUNTS['frames'] += len(spectra)
+        for spek in spectra:
+            if hpss is not None:
+                spek, harmonic_ratio = hpss(spek)
+                if harmonic_ratio < HPSS_MIN_HARMONIC_RATIO:
+                    FRAME_COUNTS['percussive'] += 1
+                    continue
+            p1, p2 = speaks(spek)
+            if SPECTRAL_WHITENING:
+                p2 = sw(spek, p1, p2)
+            pcp = hpcp(p1, p2)
+            if DETUNING_CORRECTION and DETUNING_CORRECTION_SCOPE == 'frame':
+                pcp = postprocess_pcp(pcp, True, 0, True)
+            chroma.append(pcp)
+    if not chroma:
+        return np.zeros([1, hpcp_size], dtype='float32')
+    return np.array(chroma, dtype='float32')
+
+
+def chroma_key(chroma, with_margin=False, with_probability=False):
+    """
+    Estimates the key of a track from its frame-wise pcps.
+    Returns the key and the mode separated by a tab and, optionally,
+    the first to second ratio of the key correlation and the calibrated
+    probability of the key (from the profiles it was estimated with).
+    Pcps with more than 12 bins are folded into 12 after detuning correction.
+    :type chroma: np.ndarray
+    :type with_margin: bool
+    :type with_probability: bool
+    """
+    chroma = accumulate_pcp(chroma, FRAME_WEIGHTING)
+    average_shift = DETUNING_CORRECTION and DETUNING_CORRECTION_SCOPE == 'average'
+    # referenceShift=-3 adjusts to essentia's HPCP calculation starting on A...
+    chroma = postprocess_pcp(chroma, PCP_THRESHOLD is not None or average_shift, PCP_THRESHOLD or 0,
+                             average_shift, -3)
+    chroma = fold_pcp(chroma)
+    if USE_THREE_PROFILES and WITH_MODAL_DETAILS:
+        # single pass over the three-profile and modal templates,
+        # assigning monotonic tracks to minor:
+        tonic, scale, estimation_1, estimation_2 = template_matching_ensemble(chroma, KEY_PROFILE,
+                                                                              temperature=KEY_TEMPERATURE)
+        key = tonic + '\t' + scale
     else:
-        estimation_1 = template_matching_2(chroma, KEY_PROFILE)
+        # the probability, if needed, comes from the same profiles as the key
+        temperature = KEY_TEMPERATURE if with_probability else None
+        if USE_THREE_PROFILES:
+            estimation_1 = template_matching_3(chroma, KEY_PROFILE, temperature)
+        else:
+            estimation_1 = template_matching_2(chroma, KEY_PROFILE, temperature)
+        key = key_from_estimations(chroma, estimation_1)
+    result = (key,)
+    if with_margin:
+        result += (estimation_1[3],)
+    if with_probability:
+        result += (estimation_1[4],)
+    return result if len(result) > 1 else key
+
+
+def key_from_estimations(chroma, estimation_1):
+    """
+    Combines a two or three profile estimation with the modal one,
+    assigning monotonic tracks to minor.
+    :type chroma: np.ndarray (12 bins)
+    :type estimation_1: tuple (as returned by template_matching_3)
+    """
     key_1 = estimation_1[0] + '\t' + estimation_1[1]
     if WITH_MODAL_DETAILS:
         estimation_2 = template_matching_modal(chroma)
@@ -184,12 +567,211 @@ def estimate_key(input_audio_file, output_text_file):
             key = key_1
     else:
         key = key_1
-    textfile = open(output_text_file, 'w')
-    textfile.write(key + '\n')
-    textfile.close()
     return key
 
 
+def audio_key(audio, chain, fine_chain=None, fast=None):
+    """
+    Estimates the key of a mono signal. Returns the key and mode
+    separated by a tab, and the frame-wise pcps they were estimated from.
+    In fast mode, only FAST_EXCERPTS excerpts of the signal are analysed.
+    In COARSE_TO_FINE mode, the signal is analysed with 'chain' (12 bins),
+    and analysed again with 'fine_chain' (FINE_HPCP_SIZE bins, created
+    if None) only if it is detuned or its key is ambiguous.
+    :type audio: np.ndarray
+    :type chain: tuple (as returned by key_chain)
+    :type fine_chain: tuple (as returned by key_chain)
+    :type fast: bool, FAST_MODE if None
+    """
+    if FAST_MODE if fast is None else fast:
+        chroma = excerpts_chroma(audio_excerpts(audio, FAST_EXCERPTS, FAST_EXCERPT_SECONDS), chain)
+        return chroma_key(chroma), chroma
+    if not COARSE_TO_FINE:
+        chroma = audio_chroma(audio, chain)
+        return chroma_key(chroma), chroma
+    chroma, cents = audio_chroma(audio, chain, with_tuning=True)
+    if ESCALATE_PROBABILITY is None:
+        key, margin = chroma_key(chroma, with_margin=True)
+        confident = margin >= ESCALATE_MARGIN
+    else:
+        key, probability = chroma_key(chroma, with_probability=True)
+        confident = probability >= ESCALATE_PROBABILITY
+    if abs(cents) <= ESCALATE_DETUNING_CENTS and confident:
+        return key, chroma
+    if fine_chain is None:
+        fine_chain = key_chain(FINE_HPCP_SIZE)
+    chroma = audio_chroma(audio, fine_chain)
+    return chroma_key(chroma), chroma
+
+
+_result_cache = None
+
+
+# Settings that can change the estimated key. Output and storage settings
+# (VALID_FILE_TYPES, BATCH_OUTPUT, CHROMA_ARCHIVE_DIR, RESULT_CACHE) are left
+# out, so that they do not invalidate the cached results.
+ANALYSIS_SETTINGS = ('SAMPLE_RATE',
+                     'HIGHPASS_CUTOFF', 'SILENCE_THRESHOLD_DB', 'SPECTRAL_WHITENING',
+                     'HPSS', 'HPSS_TIME_FRAMES', 'HPSS_FREQUENCY_BINS', 'HPSS_MIN_HARMONIC_RATIO',
+                     'DETUNING_CORRECTION', 'DETUNING_CORRECTION_SCOPE', 'PCP_THRESHOLD', 'FRAME_WEIGHTING',
+                     'WINDOW_SIZE', 'HOP_SIZE', 'WINDOW_SHAPE', 'MIN_HZ', 'MAX_HZ',
+                     'SPECTRAL_PEAKS_THRESHOLD', 'SPECTRAL_PEAKS_MAX',
+                     'HPCP_BAND_PRESET', 'HPCP_SPLIT_HZ', 'HPCP_HARMONICS', 'HPCP_NON_LINEAR',
+                     'HPCP_NORMALIZE', 'HPCP_SHIFT', 'HPCP_REFERENCE_HZ', 'HPCP_SIZE',
+                     'HPCP_WEIGHT_WINDOW_SEMITONES', 'HPCP_WEIGHT_TYPE',
+                     'COARSE_TO_FINE', 'FINE_HPCP_SIZE',
+                     'ESCALATE_DETUNING_CENTS', 'ESCALATE_MARGIN', 'ESCALATE_PROBABILITY',
+                     'FAST_MODE', 'FAST_EXCERPTS', 'FAST_EXCERPT_SECONDS',
+                     'KEY_PROFILE', 'USE_THREE_PROFILES', 'WITH_MODAL_DETAILS', 'KEY_TEMPERATURE')
+
+
+def analysis_settings():
+    """
+    Returns the settings that can change the estimated key, as a dict,
+    to tell apart the cached results of different configurations: the
+    ANALYSIS_SETTINGS and the key profiles they select, so that editing
+    the profiles in templates.py also invalidates the cache.
+    """
+    settings = dict((name, globals()[name]) for name in ANALYSIS_SETTINGS)
+    if USE_THREE_PROFILES:
+        settings['profiles'] = THREE_PROFILE_TEMPLATES[KEY_PROFILE].tolist()
+    else:
+        settings['profiles'] = TWO_PROFILE_TEMPLATES[KEY_PROFILE].tolist()
+    if WITH_MODAL_DETAILS:
+        settings['modal_profiles'] = [(mode, MODAL_TEMPLATES[mode].tolist()) for mode in sorted(MODAL_TEMPLATES)]
+    return settings
+
+
+def result_cache():
+    """
+    Returns the result cache of this process, None if RESULT_CACHE is None.
+    """
+    global _result_cache
+    if _result_cache is None and RESULT_CACHE is not None:
+        _result_cache = keycache.ResultCache(RESULT_CACHE, keycache.settings_signature(analysis_settings()))
+    return _result_cache
+
+
+def pcm_key(audio, chain, fine_chain=None):
+    """
+    Estimates the key of a mono signal through the result cache.
+    Returns the key and 'pcm' if it was found in the cache, None otherwise.
+    :type audio: np.ndarray
+    :type chain: tuple (as returned by key_chain)
+    :type fine_chain: tuple (as returned by key_chain)
+    """
+    cache = result_cache()
+    if cache is None:
+        return audio_key(audio, chain, fine_chain)[0], None
+    audio_hash = keycache.pcm_hash(audio)
+    key = cache.get('pcm', audio_hash)
+    if key is not None:
+        return key, 'pcm'
+    key = audio_key(audio, chain, fine_chain)[0]
+    cache.put('pcm', audio_hash, key)
+    return key, None
+
+
+def file_key(input_audio_file, chain, fine_chain=None):
+    """
+    Estimates the key of an audio file through the result cache, looking
+    up the file content before decoding it and the decoded signal before
+    analysing it. Returns the key and the level it was found at in the
+    cache ('file' or 'pcm'), None if it was analysed. In fast mode, only
+    the excerpts are decoded (see file_excerpts), so the decoded signal
+    is not looked up.
+    :type input_audio_file: str
+    :type chain: tuple (as returned by key_chain)
+    :type fine_chain: tuple (as returned by key_chain)
+    """
+    cache = result_cache()
+    content_hash = None
+    if cache is not None:
+        content_hash = keycache.file_hash(input_audio_file)
+        key = cache.get('file', content_hash)
+        if key is not None:
+            return key, 'file'
+    if FAST_MODE:
+        key = chroma_key(excerpts_chroma(file_excerpts(input_audio_file), chain))
+        level = None
+    else:
+        key, level = pcm_key(load_audio(input_audio_file), chain, fine_chain)
+    if cache is not None:
+        cache.put('file', content_hash, key)
+    return key, level
+
+
+def estimate_key(input_audio_file, output_text_file=None, chain=None, fine_chain=None, sink=None):
+    """
+    This function estimates the overall key of an audio track
+    optionaly with extra modal information, and writes it to
+    the sink if any, to output_text_file otherwise.
+    :type input_audio_file: str
+    :type output_text_file: str
+    :type chain: tuple (as returned by key_chain), created if None
+    :type fine_chain: tuple (as returned by key_chain), for COARSE_TO_FINE mode
+    :type sink: keysinks.Sink (as returned by keysinks.open_sink)
+    """
+    if chain is None:
+        chain = key_chain(12 if COARSE_TO_FINE else HPCP_SIZE)
+    if CHROMA_ARCHIVE_DIR is not None:
+        # the chroma is needed, the result cache is not used
+        key, chroma = audio_key(load_audio(input_audio_file), chain, fine_chain)
+        archive_name = os.path.splitext(os.path.basename(input_audio_file))[0] + '.chroma'
+        write_chroma_archive(os.path.join(CHROMA_ARCHIVE_DIR, archive_name), chroma)
+    else:
+        key = file_key(input_audio_file, chain, fine_chain)[0]
+    if sink is not None:
+        sink.write(input_audio_file, key)
+    elif output_text_file is not None:
+        textfile = open(output_text_file, 'w')
+        textfile.write(key + '\n')
+        textfile.close()
+    return key
+
+
+def compare_fast_mode(audio_files, excerpt_counts, chain, fine_chain=None):
+    """
+    Estimates the key of every file with the full analysis and with
+    every number of excerpts in excerpt_counts, taking the full analysis
+    as the reference. Returns a report with a line per number of excerpts:
+    the fraction of identical keys, the weighted MIREX score and the mean
+    time per track, decoding included: the full analysis decodes whole
+    files, fast mode only the excerpts (see file_excerpts).
+    :type audio_files: list
+    :type excerpt_counts: list
+    :type chain: tuple (as returned by key_chain)
+    :type fine_chain: tuple (as returned by key_chain), for COARSE_TO_FINE mode
+    """
+    from evaluation import key_to_list, mirex_score, mirex_evaluation
+    scores = dict((n_excerpts, []) for n_excerpts in excerpt_counts)
+    secs = dict((n_excerpts, 0.0) for n_excerpts in excerpt_counts)
+    full_secs = 0.0
+    for input_audio_file in audio_files:
+        start = time.time()
+        audio = load_audio(input_audio_file)
+        decoding_secs = time.time() - start
+        start = time.time()
+        reference = key_to_list(audio_key(audio, chain, fine_chain, fast=False)[0])
+        full_secs += decoding_secs + time.time() - start
+        for n_excerpts in excerpt_counts:
+            start = time.time()
+            excerpts = file_excerpts(input_audio_file, n_excerpts, FAST_EXCERPT_SECONDS)
+            key = chroma_key(excerpts_chroma(excerpts, chain))
+            secs[n_excerpts] += time.time() - start
+            scores[n_excerpts].append(mirex_score(key_to_list(key), reference))
+    n_files = len(audio_files)
+    if n_files == 0:
+        return "Fast mode:\tno audio files to compare"
+    lines = ["Fast mode vs full analysis ({0} tracks, {1:.3f} secs/track):".format(n_files, full_secs / n_files),
+             "excerpts\tidentical\tmirex\tsecs/track"]
+    for n_excerpts in excerpt_counts:
+        results = mirex_evaluation(scores[n_excerpts])
+        lines.append("{0}\t{1:.3f}\t{2:.3f}\t{3:.3f}".format(n_excerpts, results[0], results[5],
+                                                           secs[n_excerpts] / n_files))
+    return '\n'.join(lines)
+
+
 if __name__ == "__main__":
 
     from time import clock
@@ -203,11 +785,20 @@ if __name__ == "__main__":
     parser.add_argument("-v", "--verbose", action="store_true", help="print progress to console")
     # parser.add_argument("-x", "--extra", action="store_true", help="generate extra analysis files")
     parser.add_argument("-p", "--profile", help="specify a key template")
+    parser.add_argument("-o", "--output_format", choices=keysinks.SINK_FORMATS,
+                        help="in --batch_mode, format of the results file ('txt' for one file per track)")
+    parser.add_argument("-f", "--fast", action="store_true", help="analyse FAST_EXCERPTS excerpts of each track only")
+    parser.add_argument("--compare_fast", help="in --batch_mode, compare the full analysis with fast mode "
+                                               "for these comma separated numbers of excerpts (e.g. 2,4,8,16)")
 
     args = parser.parse_args()
 
     if args.profile:
         KEY_PROFILE = args.profile
+    if args.fast:
+        FAST_MODE = True
+    if args.output_format:
+        BATCH_OUTPUT = args.output_format
     if args.verbose:
         print('Key profile used:', KEY_PROFILE)
 
@@ -236,18 +827,32 @@ if __name__ == "__main__":
                 sys.exit()
             output_dir = results_directory(args.output)
             list_all_files = os.listdir(args.input)
+            results_path = keysinks.sink_filename(output_dir, BATCH_OUTPUT)
             print("\nAnalysing audio files in:\t{0}".format(args.input))
-            print("Writing results to:\t{0}\n".format(args.output))
+            print("Writing results to:\t{0}\n".format(results_path))
             count_files = 0
-            for a_file in list_all_files:
-                if any(soundfile_type in a_file for soundfile_type in VALID_FILE_TYPES):
-                    input_file = args.input + '/' + a_file
-                    output_file = args.output + '/' + a_file[:-4] + '.txt'
-                    estimation = estimate_key(input_file, output_file)
-                    if args.verbose:
-                        print("{0} - {1}".format(input_file, estimation))
-                    count_files += 1
+            chain = key_chain(12 if COARSE_TO_FINE else HPCP_SIZE)
+            fine_chain = key_chain(FINE_HPCP_SIZE) if COARSE_TO_FINE else None
+            analysed_files = []
+            sink = keysinks.open_sink(BATCH_OUTPUT, results_path)
+            try:
+                for a_file in list_all_files:
+                    if any(soundfile_type in a_file for soundfile_type in VALID_FILE_TYPES):
+                        input_file = args.input + '/' + a_file
+                        estimation = estimate_key(input_file, chain=chain, fine_chain=fine_chain, sink=sink)
+                        if args.verbose:
+                            print("{0} - {1}".format(input_file, estimation))
+                        analysed_files.append(input_file)
+                        count_files += 1
+            finally:
+                sink.close()
             print("{0} audio files analysed".format(count_files, clock()))
+            if args.compare_fast:
+                excerpt_counts = [int(n) for n in args.compare_fast.split(',')]
+                print(compare_fast_mode(analysed_files, excerpt_counts, chain, fine_chain))
         else:
             raise IOError("Unknown ERROR in batch mode")
+    print(frame_counts_report(FRAME_COUNTS))
+    if result_cache() is not None:
+        print(result_cache().report())
     print("Finished in:\t{0} secs.\n".format(clock()))
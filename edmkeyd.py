@@ -0,0 +1,440 @@
+#!/usr/local/bin/python
+#  -*- coding: UTF-8 -*-
+
+"""
+Key estimation daemon.
+
+Keeps the key extraction chain of edmkey.py loaded in a pool of worker
+processes and serves requests over a Unix socket, so that clients do not pay
+for python startup, the Essentia import and the construction of the
+algorithms on every track.
+
+Protocol: one JSON object per line, answered with one JSON line.
+
+    {"id": 1, "path": "/music/track.mp3"}   analyse an audio file
+    {"id": 2, "pcm": 1323000}               analyse raw audio: the line is followed
+                                            by that many bytes of little endian
+                                            float32 mono samples at SAMPLE_RATE
+    {"stats": true}                         throughput and latency metrics
+
+    -> {"id": 1, "key": "A", "scale": "minor", "cached": null, "latency": 0.41}
+    -> {"id": 2, "error": "..."}
+
+Several requests can be sent on the same connection. Requests arriving at
+the same time are grouped in batches of up to BATCH_SIZE (waiting at most
+BATCH_WINDOW secs for the batch to fill up). The jobs of a batch are sent to
+the pool together, one task each, so that they are spread across the
+workers, and requests for the same file in a batch are analysed once.
+A request that is not answered within REQUEST_TIMEOUT secs (e.g. because
+its worker died) gets an error. Raw audio requests larger than MAX_PCM_BYTES
+are refused, and the connection is closed.
+
+With edmkey.RESULT_CACHE set, the workers share a persistent cache of
+results: duplicate files are answered without decoding them, and
+decode-identical audio without analysing it ("cached": "file" or "pcm").
+With --fast, the workers only analyse a few short excerpts of every track
+(edmkey.FAST_MODE), for previews and triage.
+
+Run the daemon with 'edmkeyd.py' and try it with the stand-in client:
+'edmkeyd.py --client track1.mp3 track2.mp3 ...'.
+"""
+
+import os, stat, json, time, errno, socket, threading, multiprocessing
+from collections import deque
+
+try:
+    import socketserver
+    from queue import Queue, Empty
+except ImportError:
+    import SocketServer as socketserver
+    from Queue import Queue, Empty
+
+import numpy as np
+
+# ======================= #
+# DAEMON SETTINGS         #
+# ======================= #
+
+SOCKET_PATH                  = '/tmp/edmkeyd.sock'
+WORKERS                      = multiprocessing.cpu_count()
+BATCH_SIZE                   = 8
+BATCH_WINDOW                 = 0.01      # secs to wait for a batch to fill up
+REQUEST_TIMEOUT              = 600       # secs to wait for the result of a request
+MAX_PCM_BYTES                = 1 << 28   # largest raw audio request, about 25 minutes at 44.1 kHz
+LATENCY_WINDOW               = 10000     # number of recent requests used for the latency percentiles
+THROUGHPUT_WINDOW            = 60        # secs used for the recent throughput
+
+
+# Worker Processes
+# ----------------
+
+_chain = None
+_fine_chain = None
+
+
+def init_worker(fast=False):
+    """
+    Creates the key extraction chains once per worker process.
+    :type fast: bool, analyse excerpts only (edmkey.FAST_MODE)
+    """
+    global _chain, _fine_chain
+    import edmkey
+    if fast:
+        edmkey.FAST_MODE = True
+    if edmkey.COARSE_TO_FINE:
+        _chain = edmkey.key_chain(12)
+        _fine_chain = edmkey.key_chain(edmkey.FINE_HPCP_SIZE)
+    else:
+        _chain = edmkey.key_chain()
+
+
+def analyse_job(job):
+    """
+    Estimates the key of a job, a dict with either a 'path' to an
+    audio file or a 'pcm' signal. Returns a result dict, with the level
+    of the result cache it was found at ('cached', None if analysed).
+    :type job: dict
+    """
+    import edmkey
+    try:
+        if 'path' in job:
+            key, cached = edmkey.file_key(job['path'], _chain, _fine_chain)
+        else:
+            key, cached = edmkey.pcm_key(job['pcm'], _chain, _fine_chain)
+        key = key.split('\t')
+        return {'key': key[0], 'scale': key[1], 'cached': cached}
+    except Exception as e:
+        return {'error': str(e)}
+
+
+# Metrics
+# -------
+
+def percentile(values, q):
+    """
+    Returns the q-th percentile of a list of values, None if empty.
+    """
+    if not values:
+        return None
+    return float(np.percentile(values, q))
+
+
+class Metrics(object):
+    """
+    Request counters and a window of recent latencies.
+    """
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.start = time.time()
+        self.requests = 0
+        self.errors = 0
+        self.batches = 0
+        self.cache_hits = {'file': 0, 'pcm': 0}
+        self.latencies = deque(maxlen=LATENCY_WINDOW)
+        self.finished = deque(maxlen=LATENCY_WINDOW)
+
+    def add_batch(self):
+        with self.lock:
+            self.batches += 1
+
+    def add_request(self, latency, failed, cached=None):
+        with self.lock:
+            self.requests += 1
+            if failed:
+                self.errors += 1
+            if cached is not None:
+                self.cache_hits[cached] += 1
+            self.latencies.append(latency)
+            self.finished.append(time.time())
+
+    def snapshot(self):
+        with self.lock:
+            now = time.time()
+            uptime = now - self.start
+            latencies = list(self.latencies)
+            recent = [t for t in self.finished if t > now - THROUGHPUT_WINDOW]
+            return {'uptime': uptime,
+                    'requests': self.requests,
+                    'errors': self.errors,
+                    'batches': self.batches,
+                    'mean_batch_size': float(self.requests) / self.batches if self.batches else None,
+                    'cache_hits': dict(self.cache_hits),
+                    'cache_hit_rate': float(sum(self.cache_hits.values())) / self.requests if self.requests else None,
+                    'throughput': self.requests / uptime if uptime > 0 else None,
+                    'recent_throughput': len(recent) / float(min(uptime, THROUGHPUT_WINDOW)) if uptime > 0 else None,
+                    'latency_p50': percentile(latencies, 50),
+                    'latency_p99': percentile(latencies, 99),
+                    'latency_max': max(latencies) if latencies else None}
+
+
+# Batching
+# --------
+
+class Job(object):
+    """
+    A request waiting for its result.
+    """
+
+    def __init__(self, payload):
+        self.payload = payload
+        self.start = time.time()
+        self.task = None
+        self.error = None
+        self.sent = threading.Event()
+
+
+class Batcher(object):
+    """
+    Groups concurrent requests into batches and spreads every batch
+    over a process pool, one task per distinct request.
+    """
+
+    def __init__(self, workers, metrics, fast=False):
+        self.metrics = metrics
+        self.queue = Queue()
+        self.pool = multiprocessing.Pool(workers, initializer=init_worker, initargs=(fast,))
+        self.thread = threading.Thread(target=self.dispatch)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def submit(self, payload):
+        """
+        Queues a job and waits for its result. Failures of the task itself
+        (e.g. a payload that cannot be pickled) and requests lost with
+        their worker are answered with an error.
+        """
+        job = Job(payload)
+        self.queue.put(job)
+        job.sent.wait()
+        if job.error is not None:
+            result = {'error': job.error}
+        else:
+            try:
+                # a copy, as duplicate requests of a batch share the result
+                result = dict(job.task.get(REQUEST_TIMEOUT))
+            except multiprocessing.TimeoutError:
+                result = {'error': "No result after {0} secs".format(REQUEST_TIMEOUT)}
+            except Exception as e:
+                result = {'error': str(e) or repr(e)}
+        latency = time.time() - job.start
+        result['latency'] = latency
+        self.metrics.add_request(latency, 'error' in result, result.get('cached'))
+        return result
+
+    def dispatch(self):
+        while True:
+            batch = [self.queue.get()]
+            deadline = time.time() + BATCH_WINDOW
+            while len(batch) < BATCH_SIZE:
+                timeout = deadline - time.time()
+                if timeout <= 0:
+                    break
+                try:
+                    batch.append(self.queue.get(timeout=timeout))
+                except Empty:
+                    break
+            self.metrics.add_batch()
+            self.send(batch)
+
+    def send(self, batch):
+        tasks = {}
+        for job in batch:
+            path = job.payload.get('path')
+            try:
+                if path is not None and path in tasks:
+                    job.task = tasks[path]
+                else:
+                    job.task = self.pool.apply_async(analyse_job, (job.payload,))
+                    if path is not None:
+                        tasks[path] = job.task
+            except Exception as e:
+                job.error = str(e) or repr(e)
+            job.sent.set()
+
+    def close(self):
+        self.pool.terminate()
+
+
+# Server
+# ------
+
+class StreamError(ValueError):
+    """
+    An invalid request after which the rest of the connection cannot be
+    read, e.g. raw audio of an invalid size. It is answered, and the
+    connection closed.
+    """
+
+
+class KeyRequestHandler(socketserver.StreamRequestHandler):
+    """
+    Reads JSON requests from a connection until it is closed.
+    """
+
+    def handle(self):
+        while True:
+            line = self.rfile.readline()
+            if not line:
+                break
+            try:
+                request = json.loads(line.decode('utf-8'))
+                if not isinstance(request, dict):
+                    raise ValueError("A request must be a JSON object")
+                response = self.answer(request)
+            except StreamError as e:
+                self.reply({'error': str(e)})
+                break
+            except (ValueError, TypeError, KeyError) as e:
+                response = {'error': str(e)}
+            self.reply(response)
+
+    def reply(self, response):
+        self.wfile.write((json.dumps(response) + '\n').encode('utf-8'))
+        self.wfile.flush()
+
+    def answer(self, request):
+        if request.get('stats'):
+            return self.server.metrics.snapshot()
+        if 'path' in request:
+            payload = {'path': request['path']}
+        elif 'pcm' in request:
+            n_bytes = int(request['pcm'])
+            if n_bytes <= 0 or n_bytes > MAX_PCM_BYTES:
+                raise StreamError("Raw audio must be between 1 and {0} bytes".format(MAX_PCM_BYTES))
+            data = self.rfile.read(n_bytes)
+            if len(data) != n_bytes:
+                raise StreamError("Expected {0} bytes of float32 samples".format(n_bytes))
+            if n_bytes % 4 != 0:
+                raise ValueError("Expected {0} bytes of float32 samples".format(n_bytes))
+            payload = {'pcm': np.frombuffer(data, dtype='<f4').astype('float32')}
+        else:
+            raise ValueError("A request needs a 'path', 'pcm' or 'stats' field")
+        response = self.server.batcher.submit(payload)
+        if 'id' in request:
+            response['id'] = request['id']
+        return response
+
+
+class KeyServer(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+    daemon_threads = True
+
+    def __init__(self, socket_path, workers, fast=False):
+        remove_stale_socket(socket_path)
+        # start the workers first, so that they do not inherit the listening socket
+        self.metrics = Metrics()
+        self.batcher = Batcher(workers, self.metrics, fast)
+        socketserver.UnixStreamServer.__init__(self, socket_path, KeyRequestHandler)
+
+
+def remove_stale_socket(socket_path):
+    """
+    Removes the socket left behind by a daemon that did not shut down.
+    Refuses to remove anything else, or the socket of a running daemon.
+    """
+    try:
+        mode = os.stat(socket_path).st_mode
+    except OSError:
+        return
+    if not stat.S_ISSOCK(mode):
+        raise IOError("{0} exists and is not a socket".format(socket_path))
+    probe = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    try:
+        probe.connect(socket_path)
+    except socket.error as e:
+        if e.errno != errno.ECONNREFUSED:
+            raise
+    else:
+        raise IOError("A daemon is already listening on {0}".format(socket_path))
+    finally:
+        probe.close()
+    os.remove(socket_path)
+
+
+def serve(socket_path=SOCKET_PATH, workers=WORKERS, fast=False):
+    """
+    Runs the daemon until interrupted.
+    """
+    server = KeyServer(socket_path, workers, fast)
+    print("Listening on:\t{0} ({1} workers)".format(socket_path, workers))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        server.batcher.close()
+        server.server_close()
+        os.remove(socket_path)
+
+
+# Stand-in Client
+# ---------------
+
+def request(socket_path, message, data=None):
+    """
+    Sends one request to the daemon and returns its answer.
+    :type socket_path: str
+    :type message: dict
+    :type data: bytes (raw samples for 'pcm' requests)
+    """
+    connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    connection.connect(socket_path)
+    stream = connection.makefile('rwb')
+    stream.write((json.dumps(message) + '\n').encode('utf-8'))
+    if data is not None:
+        stream.write(data)
+    stream.flush()
+    answer = json.loads(stream.readline().decode('utf-8'))
+    stream.close()
+    connection.close()
+    return answer
+
+
+def run_client(socket_path, files, send_pcm=False):
+    """
+    Sends all the files to the daemon concurrently and prints the results
+    and the daemon metrics.
+    """
+    results = [None] * len(files)
+
+    def send(n):
+        if send_pcm:
+            import edmkey
+            data = edmkey.load_audio(files[n]).astype('<f4').tobytes()
+            results[n] = request(socket_path, {'id': n, 'pcm': len(data)}, data)
+        else:
+            results[n] = request(socket_path, {'id': n, 'path': os.path.abspath(files[n])})
+
+    threads = [threading.Thread(target=send, args=(n,)) for n in range(len(files))]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    for a_file, result in zip(files, results):
+        if 'error' in result:
+            print("{0}\tERROR: {1}".format(a_file, result['error']))
+        else:
+            print("{0}\t{1}\t{2}\t({3:.3f} secs)".format(a_file, result['key'], result['scale'], result['latency']))
+    print(json.dumps(request(socket_path, {'stats': True}), indent=2, sort_keys=True))
+
+
+if __name__ == "__main__":
+
+    from argparse import ArgumentParser
+
+    parser = ArgumentParser(description="Key Estimation Daemon")
+    parser.add_argument("files", nargs="*", help="audio files to send in --client mode")
+    parser.add_argument("-s", "--socket", default=SOCKET_PATH, help="path of the unix socket")
+    parser.add_argument("-w", "--workers", type=int, default=WORKERS, help="number of worker processes")
+    parser.add_argument("-c", "--client", action="store_true", help="send the files to a running daemon")
+    parser.add_argument("--pcm", action="store_true", help="in --client mode, send decoded samples instead of paths")
+    parser.add_argument("-f", "--fast", action="store_true", help="analyse edmkey.FAST_EXCERPTS excerpts of each track only")
+
+    args = parser.parse_args()
+
+    if args.client:
+        if not args.files:
+            parser.error("--client needs at least one audio file")
+        run_client(args.socket, args.files, args.pcm)
+    else:
+        serve(args.socket, args.workers, args.fast)
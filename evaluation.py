@@ -2,6 +2,7 @@
 #  -*- coding: UTF-8 -*-
 
 import os
+import keysinks
 from numpy import divide, mean, array, zeros
 
 
@@ -48,6 +49,24 @@ def merge_files(dir_with_files, new_filename):
     o.close()
 
 
+def read_estimations(estimations):
+    """
+    Returns the estimated keys of a dir with a text file per track, or of
+    a batch results file (see keysinks.read_results), as a list of
+    (name, key) pairs, where name is the file or track name.
+    :type estimations: str
+    """
+    if os.path.isfile(estimations):
+        return [(os.path.basename(track), key) for track, key in keysinks.read_results(estimations)]
+    pairs = []
+    for element in os.listdir(estimations):
+        if element[-4:] == '.key' or element[-4:] == '.txt':
+            est_file = open(estimations + '/' + element, 'r')
+            pairs.append((element, est_file.readline()))
+            est_file.close()
+    return pairs
+
+
 def name_to_class(key):
     """
     Converts a note name to its pitch-class value.
@@ -216,7 +235,7 @@ if __name__ == "__main__":
     parser.add_argument("annotations",
                         help="dir with ground-truth key annotations.")
     parser.add_argument("estimations",
-                        help="dir with estimated keys.")
+                        help="dir with estimated keys, or a batch results file (.jsonl, .csv or .bin).")
     parser.add_argument("-t" "--analysis_type",
                         help="type of analysis to perform ({'mirex', 'detailed'}.")
     parser.add_argument("-v", "--verbose",
@@ -227,51 +246,48 @@ if __name__ == "__main__":
 
     args = parser.parse_args()
 
-    if not os.path.isdir(args.estimations) and not os.path.isdir(args.annotations):
-        raise parser.error("Warning: '{0}' or '{1}' not a directory.".format(args.annotations,
-                                                                             args.estimations))
+    if not os.path.exists(args.estimations) and not os.path.isdir(args.annotations):
+        raise parser.error("Warning: '{0}' not a directory or '{1}' not found.".format(args.annotations,
+                                                                                      args.estimations))
     else:
+        # mirex.txt and the spreadsheets go next to a results file
+        results_dir = args.estimations if os.path.isdir(args.estimations) else os.path.dirname(os.path.abspath(args.estimations))
         keys_matrix = (2 * 12) * (2 * 12) * [0]
         error_matrix = array(zeros(24 * 2).reshape(24, 2), dtype=int)
         results_mirex = []
         results_errors = []
-        estimation_files = os.listdir(args.estimations)
-        for element in estimation_files:
-            if element[-4:] == '.key' or element[-4:] == '.txt':
-                est_file = open(args.estimations + '/' + element, 'r')
-                est_string = est_file.readline()
-                # TODO: reimplement detailed estimations... csv's
-                # est_string = est_string.split(', ')
-                est = key_to_list(est_string)
-                est_file.close()
+        for element, est_string in read_estimations(args.estimations):
+            # TODO: reimplement detailed estimations... csv's
+            # est_string = est_string.split(', ')
+            est = key_to_list(est_string)
+            try:
+                # we assume that file names of estimations and annotations are equal!
+                ann_file = open(args.annotations + '/' + element[:-4] + '.txt', 'r')
+            except IOError:
                 try:
-                    # we assume that file names of estimations and annotations are equal!
-                    ann_file = open(args.annotations + '/' + element[:-4] + '.txt', 'r')
+                    ann_file = open(args.annotations + '/' + element[:-4] + '.key', 'r')
                 except IOError:
-                    try:
-                        ann_file = open(args.annotations + '/' + element[:-4] + '.key', 'r')
-                    except IOError:
-                        print "Didn't find a matching annotation for the current estimation...\n"
-                        continue
-                ann_key = ann_file.readline()
-                ann = key_to_list(ann_key)
-                ann_file.close()
-                score_mirex = mirex_score(est, ann)
-                results_mirex.append(score_mirex)
-                # FROM EVALUATION SIMPLE:
-                # score_mirex = str(score_mirex)
-                type_error = error_detail(est, ann)
-                results_errors.append(type_error[0])
-                type_error = type_error[1]
-                if args.verbose:
-                    print "{0} - {1} as {2}, {3} = {4}".format(element,
-                                                               est,
-                                                               ann,
-                                                               type_error,
-                                                               score_mirex)
-                xpos = (ann[0] + (ann[0] * 24)) + (ann[1] * 24 * 12)
-                ypos = ((est[0] - est[0]) + (est[1] * 12))
-                keys_matrix[(xpos + ypos)] = + keys_matrix[(xpos + ypos)] + 1
+                    print "Didn't find a matching annotation for the current estimation...\n"
+                    continue
+            ann_key = ann_file.readline()
+            ann = key_to_list(ann_key)
+            ann_file.close()
+            score_mirex = mirex_score(est, ann)
+            results_mirex.append(score_mirex)
+            # FROM EVALUATION SIMPLE:
+            # score_mirex = str(score_mirex)
+            type_error = error_detail(est, ann)
+            results_errors.append(type_error[0])
+            type_error = type_error[1]
+            if args.verbose:
+                print "{0} - {1} as {2}, {3} = {4}".format(element,
+                                                           est,
+                                                           ann,
+                                                           type_error,
+                                                           score_mirex)
+            xpos = (ann[0] + (ann[0] * 24)) + (ann[1] * 24 * 12)
+            ypos = ((est[0] - est[0]) + (est[1] * 12))
+            keys_matrix[(xpos + ypos)] = + keys_matrix[(xpos + ypos)] + 1
         # GENERAL EVALUATION
         # ==================
         mirex_results = mirex_evaluation(results_mirex)
@@ -282,7 +298,7 @@ if __name__ == "__main__":
         # WRITE RESULTS TO FILE
         # =====================
         if args.write_results:
-            write_score = open(args.estimations + '/mirex.txt', 'w')
+            write_score = open(results_dir + '/mirex.txt', 'w')
             write_score.write("%.3f\tcorrect\n" % mirex_results[0])
             write_score.write("%.3f\tfifth errors\n" % mirex_results[1])
             write_score.write("%.3f\trelative errors\n" % mirex_results[2])
@@ -296,7 +312,7 @@ if __name__ == "__main__":
                                         'i', 'bii', 'ii', 'biii', 'iii', 'iv',
                                         '#iv', 'v', 'bvi', 'vi', 'bvii', 'vii'),
                             label_cols=('I', 'i'),
-                            filename=args.estimations + '/errors.xls')
+                            filename=results_dir + '/errors.xls')
             matrix_to_excel(keys_matrix,
                             label_rows=('C', 'C#', 'D', 'Eb', 'E', 'F',
                                         'F#', 'G', 'G#', 'A', 'Bb', 'B',
@@ -306,8 +322,9 @@ if __name__ == "__main__":
                                         'F#', 'G', 'G#', 'A', 'Bb', 'B',
                                         'Cm', 'C#m', 'Dm', 'Ebm', 'Em', 'Fm',
                                         'F#m', 'Gm', 'G#m', 'Am', 'Bbm', 'Bm'),
-                            filename=args.estimations + '/confusion_matrix.xls')
-            merge_files(args.estimations, args.estimations + '/merged_results.csv')
+                            filename=results_dir + '/confusion_matrix.xls')
+            if os.path.isdir(args.estimations):
+                merge_files(args.estimations, args.estimations + '/merged_results.csv')
 
         # PRINT RESULTS
         # =============
@@ -0,0 +1,74 @@
+#!/usr/local/bin/python
+#  -*- coding: UTF-8 -*-
+
+"""
+Frame-wise helpers shared by edmkey.py and legacy/edmkey_essentia_legacy.py,
+so that both scripts gate, count and weight their frames in the same way.
+
+Each script keeps its own counts of the frames analysed and skipped, as a
+dict with 'frames', 'silent' and 'percussive' keys.
+"""
+
+import numpy as np
+
+
+def silent_frame(frame, threshold_db):
+    """
+    True if the mean energy of a frame is below threshold_db (dB relative
+    to full scale). Those frames would only add a near-zero pcp to the track.
+    :type frame: np.ndarray
+    :type threshold_db: float, None to disable the gate
+    """
+    if threshold_db is None:
+        return False
+    return np.dot(frame, frame) < len(frame) * 10 ** (threshold_db / 10.)
+
+
+def frame_counts_report(frame_counts):
+    """
+    Returns a line with the number of frames skipped by the silence gate
+    and HPSS since the start.
+    :type frame_counts: dict {'frames', 'silent', 'percussive'}
+    """
+    frames = max(frame_counts['frames'], 1)
+    return "Skipped frames:\t{0} silent ({1:.1%}), {2} percussive ({3:.1%}) of {4}".format(
+        frame_counts['silent'], frame_counts['silent'] / float(frames),
+        frame_counts['percussive'], frame_counts['percussive'] / float(frames), frame_counts['frames'])
+
+
+def pcp_salience(chroma, weighting):
+    """
+    Tonal salience of every frame of a chromagram, as PcpAccumulator
+    computes it: (max - mean) / max for 'peakiness', one minus the
+    normalized entropy for 'entropy', 1 for 'none'. Frames with a few
+    strong pitch classes weigh close to 1, flat and empty frames close to 0.
+    :type chroma: np.ndarray (frames x bins)
+    :type weighting: str {'none', 'peakiness', 'entropy'}
+    """
+    if weighting == 'none':
+        return np.ones(len(chroma))
+    sums = np.sum(chroma, axis=1)
+    valid = sums > 0
+    salience = np.zeros(len(chroma))
+    if weighting == 'peakiness':
+        maxima = np.max(chroma[valid], axis=1)
+        salience[valid] = (maxima - sums[valid] / chroma.shape[1]) / maxima
+    elif weighting == 'entropy':
+        p = chroma[valid] / sums[valid][:, np.newaxis]
+        entropy = -np.sum(p * np.log(np.where(p > 0, p, 1)), axis=1)
+        salience[valid] = 1 - entropy / np.log(chroma.shape[1])
+    else:
+        raise NameError("FRAME_WEIGHTING must be set to 'none', 'peakiness' or 'entropy'.")
+    return salience
+
+
+def accumulate_pcp(chroma, weighting):
+    """
+    Sums the frames of a chromagram, weighted by their tonal salience
+    (see pcp_salience) unless weighting is 'none'.
+    :type chroma: np.ndarray (frames x bins)
+    :type weighting: str {'none', 'peakiness', 'entropy'}
+    """
+    if weighting == 'none':
+        return np.sum(chroma, axis=0)
+    return np.dot(pcp_salience(chroma, weighting), chroma)
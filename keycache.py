@@ -0,0 +1,116 @@
+#!/usr/local/bin/python
+#  -*- coding: UTF-8 -*-
+
+"""
+Persistent cache of key estimations, so that duplicate tracks of a
+collection are only analysed once.
+
+Results are stored in a sqlite file under two kinds of content hashes:
+
+    file    hash of the bytes of the audio file, checked before decoding,
+            for byte-identical copies
+    pcm     hash of the decoded samples, for the same audio in different
+            containers or with different tags
+
+Both are combined with a signature of the analysis settings, so changing
+any setting starts a new set of results. Every process opens its own
+connection, and sqlite serialises the writes of concurrent processes.
+"""
+
+import hashlib
+import sqlite3
+import numpy as np
+
+CHUNK_SIZE = 1 << 20
+
+
+def settings_signature(settings):
+    """
+    Returns a short hash of a dict of settings.
+    :type settings: dict
+    """
+    return hashlib.sha1(repr(sorted(settings.items())).encode('utf-8')).hexdigest()[:16]
+
+
+def file_hash(filename):
+    """
+    Hash of the content of a file, read in chunks.
+    :type filename: str
+    """
+    digest = hashlib.sha1()
+    with open(filename, 'rb') as f:
+        chunk = f.read(CHUNK_SIZE)
+        while chunk:
+            digest.update(chunk)
+            chunk = f.read(CHUNK_SIZE)
+    return digest.hexdigest()
+
+
+def pcm_hash(audio):
+    """
+    Hash of a decoded signal, as little endian float32 samples.
+    :type audio: np.ndarray
+    """
+    return hashlib.sha1(np.ascontiguousarray(audio, dtype='<f4').tobytes()).hexdigest()
+
+
+class ResultCache(object):
+    """
+    Key estimations by content hash, with lookup counters per hash kind.
+    """
+
+    def __init__(self, filename, signature):
+        self.signature = signature
+        self.connection = sqlite3.connect(filename, timeout=30)
+        self.connection.execute("CREATE TABLE IF NOT EXISTS results (id TEXT PRIMARY KEY, result TEXT)")
+        self.connection.commit()
+        self.lookups = {'file': 0, 'pcm': 0}
+        self.hits = {'file': 0, 'pcm': 0}
+
+    def _id(self, kind, content_hash):
+        return '{0}:{1}:{2}'.format(kind, content_hash, self.signature)
+
+    def get(self, kind, content_hash):
+        """
+        Returns the stored result, None if there is none.
+        :type kind: str {'file', 'pcm'}
+        :type content_hash: str
+        """
+        self.lookups[kind] += 1
+        row = self.connection.execute("SELECT result FROM results WHERE id = ?",
+                                      (self._id(kind, content_hash),)).fetchone()
+        if row is None:
+            return None
+        self.hits[kind] += 1
+        return row[0]
+
+    def put(self, kind, content_hash, result):
+        """
+        Stores a result, replacing any previous one.
+        :type kind: str {'file', 'pcm'}
+        :type content_hash: str
+        :type result: str
+        """
+        self.connection.execute("INSERT OR REPLACE INTO results (id, result) VALUES (?, ?)",
+                                (self._id(kind, content_hash), result))
+        self.connection.commit()
+
+    def hit_rate(self):
+        """
+        Fraction of the requests answered from the cache, at any level.
+        A request is a pcm lookup, or a file lookup that hits (the
+        misses are followed by a pcm lookup of the decoded file).
+        """
+        requests = self.hits['file'] + self.lookups['pcm']
+        if requests <= 0:
+            return None
+        return float(self.hits['file'] + self.hits['pcm']) / requests
+
+    def report(self):
+        """
+        Returns a line with the lookups and hits of every level.
+        """
+        hit_rate = self.hit_rate()
+        return "Result cache:\t{0}/{1} file hits, {2}/{3} pcm hits, hit rate {4}".format(
+            self.hits['file'], self.lookups['file'], self.hits['pcm'], self.lookups['pcm'],
+            '-' if hit_rate is None else '{0:.1%}'.format(hit_rate))
@@ -0,0 +1,242 @@
+#!/usr/local/bin/python
+#  -*- coding: UTF-8 -*-
+
+"""
+Output sinks for the key estimations of batch runs.
+
+Instead of one small text file per track, the results of a batch go to a
+single file, written by a background thread through a large buffer:
+
+    jsonl   one JSON object per line: {"track": ..., "key": ..., "scale": ...}
+    csv     track, key and scale columns, with a header
+    bin     compact binary file (see BinarySink)
+    txt     one text file per track, as estimate_key writes them
+            (compatibility only)
+
+All of them are opened with open_sink and fed with write(track, key),
+where key is the key and mode separated by a tab. close() waits for the
+pending results and raises any error of the writer thread. A sink replaces
+the results file of a previous run, so that re-running a batch into the
+same dir does not duplicate its results.
+read_results reads the first three back.
+"""
+
+import os, sys, csv, json, struct, threading
+
+try:
+    from queue import Queue
+except ImportError:
+    from Queue import Queue
+
+SINK_FORMATS = ('jsonl', 'csv', 'bin', 'txt')
+BUFFER_SIZE = 1 << 20
+QUEUE_SIZE = 10000
+BINARY_MAGIC = b'EDMK\x01'
+
+
+def split_key(key):
+    """
+    Returns the tonic and the scale of a key and mode separated by a tab.
+    :type key: str
+    """
+    fields = key.strip().split('\t')
+    return fields[0], fields[1] if len(fields) > 1 else ''
+
+
+class Sink(object):
+    """
+    Writes results from a background thread, so that the analysis does
+    not wait for the storage. Subclasses implement open_file, write_result
+    and close_file, which are only called from the writer thread.
+    """
+
+    def __init__(self, path):
+        self.path = path
+        self.count = 0
+        self.error = None
+        self.queue = Queue(QUEUE_SIZE)
+        self.thread = threading.Thread(target=self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def write(self, track, key):
+        """
+        Queues the result of a track.
+        :type track: str
+        :type key: str (key and mode separated by a tab)
+        """
+        if self.error is not None:
+            raise self.error
+        self.queue.put((track, key))
+        self.count += 1
+
+    def close(self):
+        """
+        Writes the pending results and closes the sink.
+        """
+        self.queue.put(None)
+        self.thread.join()
+        if self.error is not None:
+            raise self.error
+
+    def run(self):
+        item = ()
+        try:
+            self.open_file()
+            try:
+                item = self.queue.get()
+                while item is not None:
+                    self.write_result(*item)
+                    item = self.queue.get()
+            finally:
+                self.close_file()
+        except Exception as e:
+            self.error = e
+            # drain the queue, so that write and close do not block
+            while item is not None:
+                item = self.queue.get()
+
+    def open_file(self):
+        pass
+
+    def write_result(self, track, key):
+        raise NotImplementedError
+
+    def close_file(self):
+        pass
+
+
+class JsonLinesSink(Sink):
+    """
+    One JSON object per line, in a single file.
+    """
+
+    def open_file(self):
+        self.file = open(self.path, 'wb', BUFFER_SIZE)
+
+    def write_result(self, track, key):
+        tonic, scale = split_key(key)
+        line = json.dumps({'track': track, 'key': tonic, 'scale': scale}, sort_keys=True) + '\n'
+        self.file.write(line.encode('utf-8'))
+
+    def close_file(self):
+        self.file.close()
+
+
+class CsvSink(Sink):
+    """
+    Track, key and scale columns, with a header, in a single file.
+    """
+
+    def open_file(self):
+        if sys.version_info[0] < 3:
+            self.file = open(self.path, 'wb', BUFFER_SIZE)
+        else:
+            self.file = open(self.path, 'w', BUFFER_SIZE, newline='')
+        self.writer = csv.writer(self.file)
+        self.writer.writerow(['track', 'key', 'scale'])
+
+    def write_result(self, track, key):
+        tonic, scale = split_key(key)
+        self.writer.writerow([track, tonic, scale])
+
+    def close_file(self):
+        self.file.close()
+
+
+class BinarySink(Sink):
+    """
+    Binary file: BINARY_MAGIC, then one record per track,
+    made of the lengths of the track and the key (little endian uint16),
+    followed by both as utf-8.
+    """
+
+    def open_file(self):
+        self.file = open(self.path, 'wb', BUFFER_SIZE)
+        self.file.write(BINARY_MAGIC)
+
+    def write_result(self, track, key):
+        if not isinstance(track, bytes):
+            track = track.encode('utf-8')
+        key = key.strip()
+        if not isinstance(key, bytes):
+            key = key.encode('utf-8')
+        self.file.write(struct.pack('<HH', len(track), len(key)) + track + key)
+
+    def close_file(self):
+        self.file.close()
+
+
+class TextFilesSink(Sink):
+    """
+    One text file per track in the output dir, named as the audio file
+    without its extension. For compatibility with existing tools only.
+    """
+
+    def write_result(self, track, key):
+        textfile = open(os.path.join(self.path, os.path.basename(track)[:-4] + '.txt'), 'w')
+        textfile.write(key + '\n')
+        textfile.close()
+
+
+def sink_filename(output_dir, sink_format):
+    """
+    Returns the path of the results file of a batch in output_dir,
+    the dir itself for per-track text files.
+    :type output_dir: str
+    :type sink_format: str
+    """
+    if sink_format == 'txt':
+        return output_dir
+    return os.path.join(output_dir, 'keys.' + sink_format)
+
+
+def open_sink(sink_format, path):
+    """
+    Opens a sink of the given format.
+    :type sink_format: str {'jsonl', 'csv', 'bin', 'txt'}
+    :type path: str (results file, output dir for 'txt')
+    """
+    sinks = {'jsonl': JsonLinesSink, 'csv': CsvSink, 'bin': BinarySink, 'txt': TextFilesSink}
+    if sink_format not in sinks:
+        raise ValueError("Unknown output format '{0}', must be one of {1}".format(sink_format, SINK_FORMATS))
+    return sinks[sink_format](path)
+
+
+def read_results(filename):
+    """
+    Reads a results file written by a jsonl, csv or bin sink, according to
+    its extension. Returns a list of (track, key) pairs, with the key and
+    mode separated by a tab.
+    :type filename: str
+    """
+    results = []
+    extension = os.path.splitext(filename)[1]
+    if extension == '.jsonl':
+        with open(filename, 'rb') as f:
+            for line in f:
+                if line.strip():
+                    result = json.loads(line.decode('utf-8'))
+                    results.append((result['track'], result['key'] + '\t' + result['scale']))
+    elif extension == '.csv':
+        with open(filename, 'rb' if sys.version_info[0] < 3 else 'r') as f:
+            rows = csv.reader(f)
+            next(rows)
+            for row in rows:
+                results.append((row[0], row[1] + '\t' + row[2]))
+    elif extension == '.bin':
+        with open(filename, 'rb') as f:
+            data = f.read()
+        if data[:len(BINARY_MAGIC)] != BINARY_MAGIC:
+            raise IOError("{0} is not a binary results file".format(filename))
+        position = len(BINARY_MAGIC)
+        while position < len(data):
+            track_length, key_length = struct.unpack('<HH', data[position:position + 4])
+            position += 4
+            track = data[position:position + track_length].decode('utf-8')
+            position += track_length
+            results.append((track, data[position:position + key_length].decode('utf-8')))
+            position += key_length
+    else:
+        raise ValueError("Unknown results file type '{0}'".format(extension))
+    return results
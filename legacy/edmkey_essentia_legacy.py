@@ -4,8 +4,13 @@
 import os, sys
 import numpy as np
 
+# the modules shared with edmkey.py are in the parent dir
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+from framewise import silent_frame, frame_counts_report, accumulate_pcp
+
 import essentia
 import essentia.standard as estd
+import essentia.streaming as estr
 
 # ======================= #
 # KEY ESTIMATION SETTINGS #
@@ -18,11 +23,23 @@ VALID_FILE_TYPES             = {'.wav', '.mp3', 'flac', '.aiff', '.ogg'}
 
 # Analysis Parameters
 # -------------------
+STREAMING_ANALYSIS           = False     # decode and analyse block by block, with bounded memory
+BATCHED_SPECTRUM             = False     # frame, window and transform the whole track at once with FrameSpectrum (standard mode only)
+DIRECT_CHROMA                = False     # map spectrum bins straight to pcp bins (SpectrumHPCP), skipping peak picking (whitened per frame if SPECTRAL_WHITENING)
 HIGHPASS_CUTOFF              = 200
+SILENCE_THRESHOLD_DB         = -70       # skip frames with a lower energy (dB relative to full scale), None to disable (standard mode, without BATCHED_SPECTRUM)
 SPECTRAL_WHITENING           = True
+HPSS                         = False     # keep only the harmonic part of the spectrum (HarmonicPercussiveSeparation)
+HPSS_TIME_FRAMES             = 9         # frames of the harmonic median filter, if HPSS
+HPSS_FREQUENCY_BINS          = 17        # bins of the percussive median filter (odd), if HPSS
+HPSS_MIN_HARMONIC_RATIO      = 0.02      # skip frames with less harmonic energy than this, if HPSS (standard mode only)
+INCREMENTAL_WHITENING        = False     # keep the whitening envelope across frames (IncrementalWhitening)
+WHITENING_DECIMATION         = 4         # frames between envelope updates, if INCREMENTAL_WHITENING
+WHITENING_SMOOTHING          = 0.9       # weight of the previous envelope, if INCREMENTAL_WHITENING
 DETUNING_CORRECTION          = True
 DETUNING_CORRECTION_SCOPE    = 'average'  # {'average', 'frame'}
 PCP_THRESHOLD                = 0.2
+FRAME_WEIGHTING              = 'none'    # weight frames by their tonal salience when summing them {'none', 'peakiness', 'entropy'}
 WINDOW_SIZE                  = 4096
 HOP_SIZE                     = 4096
 WINDOW_SHAPE                 = 'hann'
@@ -44,51 +61,16 @@ HPCP_WEIGHT_TYPE             = 'cosine'  # {'none', 'cosine', 'squaredCosine'}
 # Key Detector Method
 # -------------------
 KEY_PROFILE                  = 'bgate'    # {'bgate', 'braw', 'edma', 'edmm'}
+KEY_PROFILE_FILE             = ''         # profile file written by templates.write_profile_file (KeyEDM3 only), overrides KEY_PROFILE
 USE_THREE_PROFILES           = True
 WITH_MODAL_DETAILS           = True
+TWO_STAGE_MATCHING           = False      # fold HPCP_SIZE > 12 into 12 bins before matching (KeyEDM3 only)
+QUANTIZED_MATCHING           = False      # 8-bit integer correlation (KeyEDM3 only)
+ENSEMBLE_MATCHING            = True       # three-profile and modal matching in one KeyEDMEnsemble pass (not with the two above)
 
 
-def normalize_pcp_peak(pcp):
-    """
-    Normalizes a pcp so that the maximum value is 1,
-    outputting a pcp with up to 3 decimal points.
-    """
-    pcp = np.multiply(pcp, (1 / np.max(pcp)))
-    new_format = []
-    for item in pcp:
-        new_format.append(item)
-    return np.array(new_format)
-
-
-def pcp_gate(pcp, threshold):
-    """
-    Zeroes vector elements with values under a certain threshold.
-    """
-    for i in range(len(pcp)):
-        if pcp[i] < threshold:
-            pcp[i] = 0
-    return pcp
-
-
-def shift_pcp(pcp, pcp_size=12):
-    """
-    Shifts a pcp to the nearest tempered bin.
-    :type pcp: list
-    :type pcp_size: int
-    """
-    tuning_resolution = pcp_size / 12
-    max_val = np.max(pcp)
-    if max_val <= [0]:
-        max_val = [1]
-    pcp = np.divide(pcp, max_val)
-    max_val_index = np.where(pcp == 1)
-    max_val_index = max_val_index[0][0] % tuning_resolution
-    if max_val_index > (tuning_resolution / 2):
-        shift_distance = tuning_resolution - max_val_index
-    else:
-        shift_distance = max_val_index
-    pcp = np.roll(pcp, shift_distance)
-    return pcp
+# Frames analysed and skipped since the start, by cause
+FRAME_COUNTS = {'frames': 0, 'silent': 0, 'percussive': 0}
 
 
 def results_directory(out_dir):
@@ -106,74 +88,308 @@ def results_directory(out_dir):
     return out_dir
 
 
-def estimate_key(input_audio_file, output_text_file):
+def spectral_chain(algorithms, direct=False):
     """
-    This function estimates the overall key of an audio track
-    optionaly with extra modal information.
+    Creates the algorithms going from audio to frame-wise pcps,
+    either in standard or streaming mode. If direct is True, the
+    last algorithm is a SpectrumHPCP working on the whole spectrum, which
+    whitens it itself if SPECTRAL_WHITENING, and there is no peak picking
+    nor separate whitening (sw and speaks are None).
+    :type algorithms: module (essentia.standard or essentia.streaming)
+    :type direct: bool
+    """
+    cut = algorithms.FrameCutter(frameSize=WINDOW_SIZE,
+                                 hopSize=HOP_SIZE)
+    window = algorithms.Windowing(size=WINDOW_SIZE,
+                                  type=WINDOW_SHAPE)
+    rfft = algorithms.Spectrum(size=WINDOW_SIZE)
+    if direct:
+        hpcp = algorithms.SpectrumHPCP(harmonics=HPCP_HARMONICS,
+                                       maxFrequency=MAX_HZ,
+                                       minFrequency=MIN_HZ,
+                                       normalized=HPCP_NORMALIZE,
+                                       referenceFrequency=HPCP_REFERENCE_HZ,
+                                       sampleRate=SAMPLE_RATE,
+                                       size=HPCP_SIZE,
+                                       weightType=HPCP_WEIGHT_TYPE,
+                                       windowSize=HPCP_WEIGHT_WINDOW_SEMITONES,
+                                       whitening=SPECTRAL_WHITENING)
+        return cut, window, rfft, None, None, hpcp
+    if INCREMENTAL_WHITENING:
+        sw = algorithms.IncrementalWhitening(maxFrequency=MAX_HZ,
+                                             sampleRate=SAMPLE_RATE,
+                                             decimation=WHITENING_DECIMATION,
+                                             smoothing=WHITENING_SMOOTHING)
+    else:
+        sw = algorithms.SpectralWhitening(maxFrequency=MAX_HZ,
+                                          sampleRate=SAMPLE_RATE)
+    speaks = algorithms.SpectralPeaks(magnitudeThreshold=SPECTRAL_PEAKS_THRESHOLD,
+                                      maxFrequency=MAX_HZ,
+                                      minFrequency=MIN_HZ,
+                                      maxPeaks=SPECTRAL_PEAKS_MAX,
+                                      sampleRate=SAMPLE_RATE)
+    hpcp = algorithms.HPCP(bandPreset=HPCP_BAND_PRESET,
+                           bandSplitFrequency=HPCP_SPLIT_HZ,
+                           harmonics=HPCP_HARMONICS,
+                           maxFrequency=MAX_HZ,
+                           minFrequency=MIN_HZ,
+                           nonLinear=HPCP_NON_LINEAR,
+                           normalized=HPCP_NORMALIZE,
+                           referenceFrequency=HPCP_REFERENCE_HZ,
+                           sampleRate=SAMPLE_RATE,
+                           size=HPCP_SIZE,
+                           weightType=HPCP_WEIGHT_TYPE,
+                           windowSize=HPCP_WEIGHT_WINDOW_SEMITONES,
+                           maxShifted=HPCP_SHIFT)
+    return cut, window, rfft, sw, speaks, hpcp
+
+
+def frame_detuning():
+    """
+    True if detuning has to be corrected on every frame.
+    """
+    if DETUNING_CORRECTION_SCOPE not in ('frame', 'average'):
+        raise NameError("SHIFT_SCOPE must be set to 'frame' or 'average'.")
+    return DETUNING_CORRECTION and DETUNING_CORRECTION_SCOPE == 'frame'
+
+
+def track_chroma(input_audio_file, direct=DIRECT_CHROMA):
+    """
+    Loads a whole audio track into memory and returns
+    the sum of its frame-wise pcps.
     :type input_audio_file: str
-    :type output_text_file: str
+    :type direct: bool
     """
     loader = estd.MonoLoader(filename=input_audio_file,
                              sampleRate=SAMPLE_RATE)
-    cut = estd.FrameCutter(frameSize=WINDOW_SIZE,
-                           hopSize=HOP_SIZE)
-    window = estd.Windowing(size=WINDOW_SIZE,
-                            type=WINDOW_SHAPE)
-    rfft = estd.Spectrum(size=WINDOW_SIZE)
-    sw = estd.SpectralWhitening(maxFrequency=MAX_HZ,
-                                sampleRate=SAMPLE_RATE)
-    speaks = estd.SpectralPeaks(magnitudeThreshold=SPECTRAL_PEAKS_THRESHOLD,
-                                maxFrequency=MAX_HZ,
-                                minFrequency=MIN_HZ,
-                                maxPeaks=SPECTRAL_PEAKS_MAX,
-                                sampleRate=SAMPLE_RATE)
-    hpcp = estd.HPCP(bandPreset=HPCP_BAND_PRESET,
-                     bandSplitFrequency=HPCP_SPLIT_HZ,
-                     harmonics=HPCP_HARMONICS,
-                     maxFrequency=MAX_HZ,
-                     minFrequency=MIN_HZ,
-                     nonLinear=HPCP_NON_LINEAR,
-                     normalized=HPCP_NORMALIZE,
-                     referenceFrequency=HPCP_REFERENCE_HZ,
-                     sampleRate=SAMPLE_RATE,
-                     size=HPCP_SIZE,
-                     weightType=HPCP_WEIGHT_TYPE,
-                     windowSize=HPCP_WEIGHT_WINDOW_SEMITONES,
-                     maxShifted=HPCP_SHIFT)
-    if USE_THREE_PROFILES:
-        key_1 = estd.KeyEDM3(pcpSize=HPCP_SIZE, profileType=KEY_PROFILE)
-    else:
-        key_1 = estd.KeyEDM(pcpSize=HPCP_SIZE, profileType=KEY_PROFILE)
-    if WITH_MODAL_DETAILS:
-        key_2 = estd.KeyExtended(pcpSize=HPCP_SIZE)
+    cut, window, rfft, sw, speaks, hpcp = spectral_chain(estd, direct)
+    if frame_detuning():
+        frame_postprocessing = estd.PcpPostProcessing(pcpSize=HPCP_SIZE,
+                                                      threshold=0,
+                                                      detuningCorrection=True)
     if HIGHPASS_CUTOFF is not None:
         hpf = estd.HighPass(cutoffFrequency=HIGHPASS_CUTOFF, sampleRate=SAMPLE_RATE)
         audio = hpf(hpf(hpf(loader())))
     else:
         audio = loader()
-    duration = len(audio)
-    n_slices = 1 + (duration / HOP_SIZE)
-    chroma = np.empty([n_slices, HPCP_SIZE], dtype='float32')
+    if BATCHED_SPECTRUM:
+        # frames are windowed and transformed in place, without FrameCutter and Windowing
+        frame_spectrum = estd.FrameSpectrum(frameSize=WINDOW_SIZE,
+                                            hopSize=HOP_SIZE,
+                                            type=WINDOW_SHAPE)
+        spectra = frame_spectrum(audio)
+        n_slices = len(spectra)
+    else:
+        duration = len(audio)
+        n_slices = 1 + (duration / HOP_SIZE)
+    if HPSS:
+        hpss = estd.HarmonicPercussiveSeparation(maxFrequency=MAX_HZ,
+                                                 sampleRate=SAMPLE_RATE,
+                                                 timeFrames=HPSS_TIME_FRAMES,
+                                                 frequencyBins=HPSS_FREQUENCY_BINS)
+    chroma = np.zeros([n_slices, HPCP_SIZE], dtype='float32')
+    FRAME_COUNTS['frames'] += n_slices
     for slice_n in range(n_slices):
-        spek = rfft(window(cut(audio)))
-        p1, p2 = speaks(spek)
+        if BATCHED_SPECTRUM:
+            spek = spectra[slice_n]
+        else:
+            frame = cut(audio)
+            if silent_frame(frame, SILENCE_THRESHOLD_DB):
+                FRAME_COUNTS['silent'] += 1
+                continue  # left empty
+            spek = rfft(window(frame))
+        if HPSS:
+            spek, harmonic_ratio = hpss(spek)
+            if harmonic_ratio < HPSS_MIN_HARMONIC_RATIO:
+                FRAME_COUNTS['percussive'] += 1
+                continue  # percussive frame, left empty
+        if direct:
+            pcp = hpcp(spek)
+        else:
+            p1, p2 = speaks(spek)
+            if SPECTRAL_WHITENING:
+                p2 = sw(spek, p1, p2)
+            pcp = hpcp(p1, p2)
+        if frame_detuning():
+            pcp = frame_postprocessing(pcp)
+        chroma[slice_n] = pcp
+    return essentia.array(accumulate_pcp(chroma, FRAME_WEIGHTING))
+
+
+def track_chroma_streaming(input_audio_file, direct=DIRECT_CHROMA):
+    """
+    Returns the sum of the frame-wise pcps of an audio track,
+    decoding, filtering and framing it block by block so that
+    memory use does not depend on the length of the track.
+    :type input_audio_file: str
+    :type direct: bool
+    """
+    loader = estr.MonoLoader(filename=input_audio_file,
+                             sampleRate=SAMPLE_RATE)
+    cut, window, rfft, sw, speaks, hpcp = spectral_chain(estr, direct)
+    accumulator = estr.PcpAccumulator(weighting=FRAME_WEIGHTING)
+    pool = essentia.Pool()
+    audio = loader.audio
+    if HIGHPASS_CUTOFF is not None:
+        for _ in range(3):
+            hpf = estr.HighPass(cutoffFrequency=HIGHPASS_CUTOFF, sampleRate=SAMPLE_RATE)
+            audio >> hpf.signal
+            audio = hpf.signal
+    audio >> cut.signal
+    cut.frame >> window.frame >> rfft.frame
+    spectrum = rfft.spectrum
+    if HPSS:
+        # percussive frames are not skipped in streaming mode
+        hpss = estr.HarmonicPercussiveSeparation(maxFrequency=MAX_HZ,
+                                                 sampleRate=SAMPLE_RATE,
+                                                 timeFrames=HPSS_TIME_FRAMES,
+                                                 frequencyBins=HPSS_FREQUENCY_BINS)
+        rfft.spectrum >> hpss.spectrum
+        hpss.harmonicRatio >> None
+        spectrum = hpss.harmonicSpectrum
+    if direct:
+        spectrum >> hpcp.spectrum
+    else:
+        spectrum >> speaks.spectrum
+        speaks.frequencies >> hpcp.frequencies
         if SPECTRAL_WHITENING:
-            p2 = sw(spek, p1, p2)
-        pcp = hpcp(p1, p2)
-        if not DETUNING_CORRECTION or DETUNING_CORRECTION_SCOPE == 'average':
-            chroma[slice_n] = pcp
-        elif DETUNING_CORRECTION and DETUNING_CORRECTION_SCOPE == 'frame':
-            pcp = shift_pcp(pcp, HPCP_SIZE)
-            chroma[slice_n] = pcp
+            spectrum >> sw.spectrum
+            speaks.frequencies >> sw.frequencies
+            speaks.magnitudes >> sw.magnitudes
+            sw.magnitudes >> hpcp.magnitudes
         else:
-            raise NameError("SHIFT_SCOPE must be set to 'frame' or 'average'.")
-    chroma = np.sum(chroma, axis=0)
-    if PCP_THRESHOLD is not None:
-        chroma = normalize_pcp_peak(chroma)
-        chroma = pcp_gate(chroma, PCP_THRESHOLD)
-    if DETUNING_CORRECTION and DETUNING_CORRECTION_SCOPE == 'average':
-        chroma = shift_pcp(chroma, HPCP_SIZE)
-    chroma = essentia.array(chroma)
+            speaks.magnitudes >> hpcp.magnitudes
+    if frame_detuning():
+        frame_postprocessing = estr.PcpPostProcessing(pcpSize=HPCP_SIZE,
+                                                      threshold=0,
+                                                      detuningCorrection=True)
+        hpcp.hpcp >> frame_postprocessing.pcp
+        frame_postprocessing.pcp >> accumulator.pcp
+    else:
+        hpcp.hpcp >> accumulator.pcp
+    accumulator.pcp >> (pool, 'chroma')
+    essentia.run(loader)
+    # the pool stores the single output of the accumulator as a 1 x HPCP_SIZE matrix
+    return pool['chroma'][0]
+
+
+def check_streaming_chroma(input_audio_file, tolerance=1e-3):
+    """
+    Computes the summed chroma of a track in standard and in streaming mode
+    and returns the largest difference between them, relative to the peak
+    of the standard chroma, and whether it is within tolerance. The frames
+    skipped in standard mode only (silence gate, percussive frames) are
+    kept in both for the comparison.
+    :type input_audio_file: str
+    :type tolerance: float
+    """
+    global SILENCE_THRESHOLD_DB, HPSS_MIN_HARMONIC_RATIO, BATCHED_SPECTRUM
+    settings = SILENCE_THRESHOLD_DB, HPSS_MIN_HARMONIC_RATIO, BATCHED_SPECTRUM
+    SILENCE_THRESHOLD_DB, HPSS_MIN_HARMONIC_RATIO, BATCHED_SPECTRUM = None, 0, False
+    try:
+        standard_chroma = track_chroma(input_audio_file)
+        streaming_chroma = track_chroma_streaming(input_audio_file)
+    finally:
+        SILENCE_THRESHOLD_DB, HPSS_MIN_HARMONIC_RATIO, BATCHED_SPECTRUM = settings
+    if standard_chroma.shape != streaming_chroma.shape:
+        return float('inf'), False
+    peak = np.max(np.abs(standard_chroma))
+    difference = float(np.max(np.abs(standard_chroma - streaming_chroma)) / peak) if peak > 0 else 0.0
+    return difference, difference <= tolerance
+
+
+def track_postprocessing():
+    """
+    Creates the PcpPostProcessing applied to the summed
+    chroma of a track before matching it to the key profiles.
+    """
+    average_shift = DETUNING_CORRECTION and DETUNING_CORRECTION_SCOPE == 'average'
+    return estd.PcpPostProcessing(pcpSize=HPCP_SIZE,
+                                  normalize=PCP_THRESHOLD is not None or average_shift,
+                                  threshold=PCP_THRESHOLD or 0,
+                                  detuningCorrection=average_shift)
+
+
+def annotation_key(annotations_dir, input_audio_file):
+    """
+    Returns the annotated key of an audio file, read from the .txt or
+    .key file of the same name in annotations_dir, None if not found.
+    :type annotations_dir: str
+    :type input_audio_file: str
+    """
+    name = os.path.splitext(os.path.basename(input_audio_file))[0]
+    for extension in ('.txt', '.key'):
+        annotation = os.path.join(annotations_dir, name + extension)
+        if os.path.isfile(annotation):
+            with open(annotation, 'r') as f:
+                return f.readline()
+    return None
+
+
+def compare_chroma_kernels(audio_files, annotations_dir=None):
+    """
+    Computes the chroma of every track with the peak based HPCP and with
+    the direct SpectrumHPCP kernel, and estimates its key from each of
+    them with KeyEDM3, to check how much accuracy the faster kernel gives
+    up. Returns a report with the mean cosine similarity of both summed
+    chromas, the MIREX score of the direct keys taking the peak based
+    keys as the reference and, with annotations_dir, the MIREX results
+    of both kernels against the annotated keys.
+    :type audio_files: list
+    :type annotations_dir: str (dir with a .txt or .key annotation per track)
+    """
+    from evaluation import key_to_list, mirex_score, mirex_evaluation
+    postprocessing = track_postprocessing()
+    key = estd.KeyEDM3(pcpSize=HPCP_SIZE, profileType=KEY_PROFILE)
+    similarities = []
+    agreement = []
+    scores = {'peaks': [], 'direct': []}
+    for input_audio_file in audio_files:
+        peaks_chroma = postprocessing(track_chroma(input_audio_file, direct=False))
+        direct_chroma = postprocessing(track_chroma(input_audio_file, direct=True))
+        norm = np.linalg.norm(peaks_chroma) * np.linalg.norm(direct_chroma)
+        similarities.append(float(np.dot(peaks_chroma, direct_chroma) / norm) if norm > 0 else 0.0)
+        peaks_key = key_to_list('\t'.join(key(peaks_chroma)[:2]))
+        direct_key = key_to_list('\t'.join(key(direct_chroma)[:2]))
+        agreement.append(mirex_score(direct_key, peaks_key))
+        if annotations_dir is not None:
+            annotation = annotation_key(annotations_dir, input_audio_file)
+            if annotation is None:
+                print("No annotation for {0}".format(input_audio_file))
+                continue
+            reference = key_to_list(annotation)
+            scores['peaks'].append(mirex_score(peaks_key, reference))
+            scores['direct'].append(mirex_score(direct_key, reference))
+    if not audio_files:
+        return "Chroma kernels:\tno audio files to compare"
+    lines = ["Direct vs peak based chroma ({0} tracks):".format(len(audio_files)),
+             "Mean chroma similarity:\t{0:.4f}".format(float(np.mean(similarities))),
+             "Identical keys:\t{0:.3f}".format(mirex_evaluation(agreement)[0]),
+             "MIREX score vs peak based keys:\t{0:.3f}".format(float(np.mean(agreement)))]
+    if scores['peaks']:
+        lines.append("MIREX vs annotations ({0} tracks):".format(len(scores['peaks'])))
+        lines.append("kernel\tcorrect\tfifth\trelative\tparallel\tother\tweighted")
+        for kernel in ('peaks', 'direct'):
+            lines.append(kernel + '\t' + '\t'.join("{0:.3f}".format(r) for r in mirex_evaluation(scores[kernel])))
+    return '\n'.join(lines)
+
+
+def key_from_profiles(chroma):
+    """
+    Estimates the key of a summed chroma with separate KeyEDM3 (or KeyEDM)
+    and KeyExtended passes.
+    :type chroma: np.ndarray
+    """
+    if USE_THREE_PROFILES:
+        key_1 = estd.KeyEDM3(pcpSize=HPCP_SIZE,
+                             profileType=KEY_PROFILE,
+                             profileFile=KEY_PROFILE_FILE,
+                             twoStage=TWO_STAGE_MATCHING,
+                             quantized=QUANTIZED_MATCHING)
+    else:
+        key_1 = estd.KeyEDM(pcpSize=HPCP_SIZE, profileType=KEY_PROFILE)
+    if WITH_MODAL_DETAILS:
+        key_2 = estd.KeyExtended(pcpSize=HPCP_SIZE)
     estimation_1 = key_1(chroma)
     key_1 = estimation_1[0] + '\t' + estimation_1[1]
     if WITH_MODAL_DETAILS:
@@ -189,6 +405,31 @@ def estimate_key(input_audio_file, output_text_file):
             key = key_1
     else:
         key = key_1
+    return key
+
+
+def estimate_key(input_audio_file, output_text_file):
+    """
+    This function estimates the overall key of an audio track
+    optionaly with extra modal information.
+    :type input_audio_file: str
+    :type output_text_file: str
+    """
+    postprocessing = track_postprocessing()
+    if STREAMING_ANALYSIS:
+        chroma = track_chroma_streaming(input_audio_file)
+    else:
+        chroma = track_chroma(input_audio_file)
+    chroma = postprocessing(chroma)
+    if USE_THREE_PROFILES and WITH_MODAL_DETAILS and ENSEMBLE_MATCHING \
+            and not (TWO_STAGE_MATCHING or QUANTIZED_MATCHING):
+        # fusion=modalOverride assigns monotonic tracks to minor, as key_from_profiles
+        estimation = estd.KeyEDMEnsemble(pcpSize=HPCP_SIZE,
+                                         profileType=KEY_PROFILE,
+                                         profileFile=KEY_PROFILE_FILE)(chroma)
+        key = estimation[0] + '\t' + estimation[1]
+    else:
+        key = key_from_profiles(chroma)
     textfile = open(output_text_file, 'w')
     textfile.write(key + '\n')
     textfile.close()
@@ -215,8 +456,31 @@ if __name__ == "__main__":
                         help="print progress to console")
     parser.add_argument("-p", "--profile",
                         help="specify a key template (braw, bgate, edma, edmm).")
+    parser.add_argument("-c", "--compare_kernels",
+                        action="store_true",
+                        help="compare the peak based and the direct chroma of the input file "
+                             "(of every file in the input dir in --batch_mode)")
+    parser.add_argument("-a", "--annotations",
+                        help="with --compare_kernels, dir with the annotated keys to score both kernels against")
+    parser.add_argument("-s", "--check_streaming",
+                        action="store_true",
+                        help="check that the standard and the streaming chroma of the input file are equal")
     args = parser.parse_args()
 
+    if args.check_streaming:
+        difference, equal = check_streaming_chroma(args.input)
+        print("\nStreaming chroma difference:\t{0:.6f} ({1})\n".format(difference, 'equal' if equal else 'DIFFERENT'))
+        sys.exit(0 if equal else 1)
+
+    if args.compare_kernels:
+        if args.batch_mode:
+            audio_files = [os.path.join(args.input, a_file) for a_file in sorted(os.listdir(args.input))
+                           if any(soundfile_type in a_file for soundfile_type in VALID_FILE_TYPES)]
+        else:
+            audio_files = [args.input]
+        print("\n" + compare_chroma_kernels(audio_files, args.annotations) + "\n")
+        sys.exit()
+
     if not args.batch_mode:
         if not os.path.isfile(args.input):
             print("\nWARNING:")
@@ -256,4 +520,6 @@ if __name__ == "__main__":
             print("{0} audio files analysed".format(count_files, clock()))
         else:
             raise IOError("Unknown ERROR in batch mode")
+    if not STREAMING_ANALYSIS:
+        print(frame_counts_report(FRAME_COUNTS))
     print("Finished in:\t{0} secs.\n".format(clock()))
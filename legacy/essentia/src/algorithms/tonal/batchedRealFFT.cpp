@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "batchedRealFFT.h"
+#include "fftw.h"
+#include <cmath>
+
+using namespace std;
+
+namespace essentia {
+
+BatchedRealFFT::BatchedRealFFT() :
+  _size(0), _batchSize(0), _inputStride(0), _outputStride(0),
+  _input(0), _output(0), _plan(0) {}
+
+BatchedRealFFT::~BatchedRealFFT() {
+  release();
+}
+
+void BatchedRealFFT::release() {
+  ForcedMutexLocker lock(standard::FFTW::globalFFTWMutex);
+
+  if (_plan) fftwf_destroy_plan(_plan);
+  if (_input) fftwf_free(_input);
+  if (_output) fftwf_free(_output);
+  _plan = 0;
+  _input = 0;
+  _output = 0;
+}
+
+void BatchedRealFFT::configure(int size, int batchSize) {
+  if (size == _size && batchSize == _batchSize) return;
+
+  if (size < 2 || size % 2 != 0) {
+    throw EssentiaException("BatchedRealFFT: the frame size must be even");
+  }
+  if (batchSize < 1) {
+    throw EssentiaException("BatchedRealFFT: the batch size must be positive");
+  }
+
+  release();
+
+  _size = size;
+  _batchSize = batchSize;
+  // 8 floats = 4 complex values = 32 bytes, the alignment of AVX loads
+  _inputStride = (size + 7) & ~7;
+  _outputStride = (spectrumSize() + 3) & ~3;
+
+  ForcedMutexLocker lock(standard::FFTW::globalFFTWMutex);
+
+  _input = (float*)fftwf_malloc(sizeof(float) * _inputStride * batchSize);
+  _output = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * _outputStride * batchSize);
+  fill(_input, _input + _inputStride * batchSize, 0.f);
+
+  _plan = fftwf_plan_many_dft_r2c(1, &_size, batchSize,
+                                  _input, NULL, 1, _inputStride,
+                                  _output, NULL, 1, _outputStride,
+                                  FFTW_ESTIMATE);
+  if (!_plan) {
+    _size = _batchSize = 0;
+    throw EssentiaException("BatchedRealFFT: could not create the FFTW plan");
+  }
+}
+
+void BatchedRealFFT::transform() {
+  fftwf_execute(_plan);
+}
+
+void BatchedRealFFT::magnitudes(int i, Real* magnitudes) const {
+  const fftwf_complex* spectrum = _output + i * _outputStride;
+  int n = spectrumSize();
+  for (int k=0; k<n; k++) {
+    magnitudes[k] = sqrt(spectrum[k][0] * spectrum[k][0] + spectrum[k][1] * spectrum[k][1]);
+  }
+}
+
+} // namespace essentia
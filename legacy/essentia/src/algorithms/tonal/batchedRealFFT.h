@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_BATCHEDREALFFT_H
+#define ESSENTIA_BATCHEDREALFFT_H
+
+#include "types.h"
+#include <fftw3.h>
+
+namespace essentia {
+
+/**
+  Real to complex FFT of a batch of frames with a single FFTW plan.
+
+  The frames are stored one after the other in an aligned buffer, each row
+  padded to a multiple of 8 samples so that every frame keeps the SIMD
+  alignment of the first one, and they are all transformed by one call to
+  a plan created with fftwf_plan_many_dft_r2c. The plan and the buffers are
+  kept until the frame size or the batch size change.
+
+  Plans are created and destroyed under the global FFTW mutex, as FFTW
+  planning is not thread-safe, but transform() can run concurrently on
+  different instances.
+*/
+class BatchedRealFFT {
+
+ public:
+  BatchedRealFFT();
+  ~BatchedRealFFT();
+
+  void configure(int size, int batchSize);
+
+  int size() const { return _size; }
+  int batchSize() const { return _batchSize; }
+  int spectrumSize() const { return _size / 2 + 1; }
+
+  // input samples of frame i, size() of them
+  Real* frame(int i) { return _input + i * _inputStride; }
+
+  void transform();
+
+  // writes the spectrumSize() magnitudes of frame i to 'magnitudes'
+  void magnitudes(int i, Real* magnitudes) const;
+
+ protected:
+  int _size;
+  int _batchSize;
+  int _inputStride;
+  int _outputStride;
+
+  float* _input;
+  fftwf_complex* _output;
+  fftwf_plan _plan;
+
+  void release();
+
+ private:
+  BatchedRealFFT(const BatchedRealFFT&);
+  BatchedRealFFT& operator=(const BatchedRealFFT&);
+};
+
+} // namespace essentia
+
+#endif // ESSENTIA_BATCHEDREALFFT_H
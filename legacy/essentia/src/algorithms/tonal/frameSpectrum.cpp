@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "frameSpectrum.h"
+#include "essentiamath.h"
+
+using namespace std;
+
+namespace essentia {
+namespace standard {
+
+const char* FrameSpectrum::name = "FrameSpectrum";
+const char* FrameSpectrum::category = "Standard";
+const char* FrameSpectrum::description = DOC("This algorithm cuts a signal into frames, windows them and computes their magnitude spectra in a single step. It gives the same values as the FrameCutter, Windowing and Spectrum chain, without creating a vector for every frame.\n"
+"\n"
+"Frames are read in place from the input signal, at hopSize samples from each other, and multiplied by the window while they are packed into the input buffer of a batched FFT, which transforms batchSize frames at once with a single FFTW plan, so every sample is read once and no per-frame memory is allocated. Only the first and last frames, which extend past the signal, are zero-padded.\n"
+"\n"
+"If startFromZero is false, frame i is centered at i*hopSize and frames are produced as long as they start before the end of the signal, as FrameCutter does. If it is true, frame i starts at i*hopSize and only whole frames are produced. The window definitions are those of Windowing. Windowing's zero-phase rotation is not applied, as it does not change the magnitude spectrum.\n"
+"\n"
+"FrameSpectrum will throw an exception when the frame size is odd.");
+
+
+void FrameSpectrum::configure() {
+  _frameSize = parameter("frameSize").toInt();
+  _hopSize = parameter("hopSize").toInt();
+  _startFromZero = parameter("startFromZero").toBool();
+  _batchSize = parameter("batchSize").toInt();
+
+  if (_frameSize % 2 != 0) {
+    throw EssentiaException("FrameSpectrum: the frame size must be even");
+  }
+
+  createWindow(parameter("type").toString(), parameter("normalized").toBool());
+  _fft.configure(_frameSize, _batchSize);
+}
+
+
+void FrameSpectrum::createWindow(const string& type, bool normalized) {
+  int n = _frameSize;
+  _window.resize(n);
+
+  for (int i=0; i<n; i++) {
+    if (type == "hann") {
+      _window[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / (n - 1.0));
+    }
+    else if (type == "hamming") {
+      _window[i] = 0.53836 - 0.46164 * cos(2.0 * M_PI * i / (n - 1.0));
+    }
+    else if (type == "triangular") {
+      _window[i] = 2.0 / n * (n / 2.0 - fabs((Real)(i - (n - 1.0) / 2.0)));
+    }
+    else {
+      _window[i] = 1.0;
+    }
+  }
+
+  if (normalized) {
+    Real sum = 0.0;
+    for (int i=0; i<n; i++) sum += _window[i];
+    for (int i=0; i<n; i++) _window[i] *= 2.0 / sum;
+  }
+}
+
+
+// Writes the windowed samples [start, start + frameSize) of the signal to
+// the FFT input, with zeros for the samples outside of the signal
+void FrameSpectrum::packFrame(const vector<Real>& signal, int start, Real* frame) const {
+  int size = (int)signal.size();
+  int begin = max(0, -start);
+  int end = min(_frameSize, size - start);
+
+  for (int t=0; t<begin; t++) frame[t] = 0.0;
+  if (begin < end) {
+    const Real* samples = &signal[0] + start;
+    const Real* window = &_window[0];
+    for (int t=begin; t<end; t++) frame[t] = samples[t] * window[t];
+  }
+  for (int t=max(begin, end); t<_frameSize; t++) frame[t] = 0.0;
+}
+
+
+void FrameSpectrum::compute() {
+  const vector<Real>& signal = _signal.get();
+  vector<vector<Real> >& spectrum = _spectrum.get();
+
+  int size = (int)signal.size();
+  int firstStart = _startFromZero ? 0 : -_frameSize / 2;
+  int nFrames;
+  if (_startFromZero) {
+    nFrames = size < _frameSize ? 0 : 1 + (size - _frameSize) / _hopSize;
+  }
+  else {
+    nFrames = size == 0 ? 0 : (size - firstStart + _hopSize - 1) / _hopSize;
+  }
+
+  spectrum.resize(nFrames);
+  for (int i=0; i<nFrames; i++) {
+    spectrum[i].resize(_fft.spectrumSize());
+  }
+
+  for (int first=0; first<nFrames; first+=_batchSize) {
+    int n = min(_batchSize, nFrames - first);
+    for (int j=0; j<n; j++) {
+      packFrame(signal, firstStart + (first + j) * _hopSize, _fft.frame(j));
+    }
+    _fft.transform();
+    for (int j=0; j<n; j++) {
+      _fft.magnitudes(j, &spectrum[first + j][0]);
+    }
+  }
+}
+
+} // namespace standard
+} // namespace essentia
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_FRAMESPECTRUM_H
+#define ESSENTIA_FRAMESPECTRUM_H
+
+#include "algorithm.h"
+#include "batchedRealFFT.h"
+
+namespace essentia {
+namespace standard {
+
+class FrameSpectrum : public Algorithm {
+
+ private:
+  Input<std::vector<Real> > _signal;
+  Output<std::vector<std::vector<Real> > > _spectrum;
+
+ public:
+
+  FrameSpectrum() {
+    declareInput(_signal, "signal", "the input audio signal");
+    declareOutput(_spectrum, "spectrum", "the magnitude spectrum of every windowed frame (frames x (frameSize/2+1))");
+  }
+
+  void declareParameters() {
+    declareParameter("frameSize", "the output frame size", "[2,inf)", 1024);
+    declareParameter("hopSize", "the hop size between frames", "[1,inf)", 512);
+    declareParameter("startFromZero", "whether to start the first frame at time 0 (and only output whole frames), or centered at time 0 (zero-padding the first and last frames)", "{true,false}", false);
+    declareParameter("type", "the window type", "{hamming,hann,triangular,square}", "hann");
+    declareParameter("normalized", "a boolean value to specify whether to normalize windows (to have an area of 1) and then scale by a factor of 2", "{true,false}", true);
+    declareParameter("batchSize", "the number of frames transformed at once", "[1,inf)", 16);
+  }
+
+  void compute();
+  void configure();
+
+  static const char* name;
+  static const char* category;
+  static const char* description;
+
+protected:
+  int _frameSize;
+  int _hopSize;
+  bool _startFromZero;
+  int _batchSize;
+  std::vector<Real> _window;
+  BatchedRealFFT _fft;
+
+  void createWindow(const std::string& type, bool normalized);
+  void packFrame(const std::vector<Real>& signal, int start, Real* frame) const;
+};
+
+} // namespace standard
+} // namespace essentia
+
+#endif // ESSENTIA_FRAMESPECTRUM_H
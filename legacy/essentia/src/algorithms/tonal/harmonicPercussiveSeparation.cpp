@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "harmonicPercussiveSeparation.h"
+#include <algorithm>
+#include "essentiamath.h"
+
+using namespace std;
+
+namespace essentia {
+namespace standard {
+
+const char* HarmonicPercussiveSeparation::name = "HarmonicPercussiveSeparation";
+const char* HarmonicPercussiveSeparation::category = "Spectral";
+const char* HarmonicPercussiveSeparation::description = DOC("This algorithm separates the harmonic component of a magnitude spectrum from the percussive one by median filtering, frame by frame.\n"
+"\n"
+"Harmonic sounds are stable across frames and percussive ones are spread across frequencies. For every bin, the median of its magnitude over the last timeFrames frames enhances the harmonic component, and the median over the frequencyBins bins around it in the current frame enhances the percussive component [1]. The spectrum is then multiplied by a mask built from both: with the binary mask the bins where the harmonic estimate is larger are kept, and with the soft mask every bin is weighted by H^2 / (H^2 + P^2).\n"
+"\n"
+"Only the spectrum up to maxFrequency is processed, and only the last timeFrames frames of it are kept, so the state does not depend on the length of the track. The median across frames is causal, over the current frame and the previous ones, so there is no output delay; the onsets of harmonic sounds are attenuated during the first timeFrames/2 frames. The output only depends on the frames processed since the last reset, so reset must be called between tracks.\n"
+"\n"
+"The harmonicRatio output can be used to skip frames that are mostly percussive, such as isolated kicks, before peak detection and HPCP.\n"
+"\n"
+"HarmonicPercussiveSeparation will throw an exception when frequencyBins is even or maxFrequency is above the Nyquist frequency.\n"
+"\n"
+"References:\n"
+"  [1] D. Fitzgerald, \"Harmonic/Percussive Separation using Median\n"
+"  Filtering,\" Proceedings of the 13th International Conference on Digital\n"
+"  Audio Effects (DAFx-10), Graz, 2010.");
+
+
+void HarmonicPercussiveSeparation::configure() {
+  _maxFrequency = parameter("maxFrequency").toReal();
+  _sampleRate = parameter("sampleRate").toReal();
+  _timeFrames = parameter("timeFrames").toInt();
+  _frequencyBins = parameter("frequencyBins").toInt();
+  _softMask = parameter("mask").toString() == "soft";
+
+  if (_maxFrequency > _sampleRate / 2.0) {
+    throw EssentiaException("HarmonicPercussiveSeparation: maxFrequency must not be higher than the Nyquist frequency");
+  }
+  if (_frequencyBins % 2 == 0) {
+    throw EssentiaException("HarmonicPercussiveSeparation: frequencyBins must be odd");
+  }
+
+  _buffer.resize(max(_timeFrames, _frequencyBins));
+  reset();
+}
+
+
+void HarmonicPercussiveSeparation::reset() {
+  _history.clear();
+  _bins = 0;
+  _frames = 0;
+  _next = 0;
+}
+
+
+// median of the n values of 'values', reordering them
+static inline Real inPlaceMedian(Real* values, int n) {
+  nth_element(values, values + n/2, values + n);
+  return values[n/2];
+}
+
+
+void HarmonicPercussiveSeparation::compute() {
+  const vector<Real>& spectrum = _spectrum.get();
+  vector<Real>& harmonicSpectrum = _harmonicSpectrum.get();
+
+  int spectrumSize = (int)spectrum.size();
+  harmonicSpectrum.assign(spectrumSize, (Real)0.0);
+  if (spectrumSize < 2) {
+    _harmonicRatio.get() = 0.0;
+    return;
+  }
+
+  Real binWidth = _sampleRate / (2.0 * (spectrumSize - 1));
+  int bins = min(spectrumSize, (int)(_maxFrequency / binWidth) + 1);
+
+  // a new spectrum size starts a new history
+  if (bins != _bins) {
+    reset();
+    _bins = bins;
+    _history.resize(_timeFrames * bins);
+  }
+
+  copy(spectrum.begin(), spectrum.begin() + bins, _history.begin() + _next * bins);
+  _next = (_next + 1) % _timeFrames;
+  if (_frames < _timeFrames) _frames++;
+
+  int halfBins = _frequencyBins / 2;
+  Real* buffer = &_buffer[0];
+  Real energy = 0.0;
+  Real harmonicEnergy = 0.0;
+
+  for (int k=0; k<bins; k++) {
+    for (int f=0; f<_frames; f++) buffer[f] = _history[f*bins + k];
+    Real harmonic = inPlaceMedian(buffer, _frames);
+
+    int first = max(0, k - halfBins);
+    int last = min(bins, k + halfBins + 1);
+    copy(spectrum.begin() + first, spectrum.begin() + last, buffer);
+    Real percussive = inPlaceMedian(buffer, last - first);
+
+    Real weight;
+    if (_softMask) {
+      Real h2 = harmonic * harmonic;
+      Real p2 = percussive * percussive;
+      weight = h2 + p2 > 0 ? h2 / (h2 + p2) : 0.0;
+    }
+    else {
+      weight = harmonic > percussive ? 1.0 : 0.0;
+    }
+
+    harmonicSpectrum[k] = weight * spectrum[k];
+    energy += spectrum[k] * spectrum[k];
+    harmonicEnergy += harmonicSpectrum[k] * harmonicSpectrum[k];
+  }
+
+  _harmonicRatio.get() = energy > 0 ? harmonicEnergy / energy : 0.0;
+}
+
+} // namespace standard
+} // namespace essentia
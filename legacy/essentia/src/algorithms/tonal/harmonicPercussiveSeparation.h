@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_HARMONICPERCUSSIVESEPARATION_H
+#define ESSENTIA_HARMONICPERCUSSIVESEPARATION_H
+
+#include "algorithm.h"
+
+namespace essentia {
+namespace standard {
+
+class HarmonicPercussiveSeparation : public Algorithm {
+
+ private:
+  Input<std::vector<Real> > _spectrum;
+  Output<std::vector<Real> > _harmonicSpectrum;
+  Output<Real> _harmonicRatio;
+
+ public:
+
+  HarmonicPercussiveSeparation() {
+    declareInput(_spectrum, "spectrum", "the audio linear spectrum");
+    declareOutput(_harmonicSpectrum, "harmonicSpectrum", "the harmonic component of the spectrum, zero above maxFrequency");
+    declareOutput(_harmonicRatio, "harmonicRatio", "the energy of the harmonic component relative to the energy of the spectrum up to maxFrequency (0 for silent frames)");
+  }
+
+  void declareParameters() {
+    declareParameter("maxFrequency", "the maximum frequency of the separation, the spectrum above it is discarded [Hz]", "(0,inf)", 5000.0);
+    declareParameter("sampleRate", "the sampling rate of the audio signal [Hz]", "(0,inf)", 44100.0);
+    declareParameter("timeFrames", "the length of the median filter across frames, which enhances the harmonic component", "[1,inf)", 9);
+    declareParameter("frequencyBins", "the length (odd) of the median filter across bins, which enhances the percussive component", "[1,inf)", 17);
+    declareParameter("mask", "the mask applied to the spectrum: binary (harmonic bins kept, others zeroed) or soft (Wiener-like, with squared magnitudes)", "{binary,soft}", "soft");
+  }
+
+  void compute();
+  void configure();
+  void reset();
+
+  static const char* name;
+  static const char* category;
+  static const char* description;
+
+protected:
+  Real _maxFrequency;
+  Real _sampleRate;
+  int _timeFrames;
+  int _frequencyBins;
+  bool _softMask;
+
+  // the last timeFrames spectra up to maxFrequency, as a ring buffer of
+  // _bins values per frame
+  std::vector<Real> _history;
+  int _bins;
+  int _frames;
+  int _next;
+
+  std::vector<Real> _buffer;
+};
+
+} // namespace standard
+} // namespace essentia
+
+#include "streamingalgorithmwrapper.h"
+
+namespace essentia {
+namespace streaming {
+
+class HarmonicPercussiveSeparation : public StreamingAlgorithmWrapper {
+
+ protected:
+  Sink<std::vector<Real> > _spectrum;
+  Source<std::vector<Real> > _harmonicSpectrum;
+  Source<Real> _harmonicRatio;
+
+ public:
+  HarmonicPercussiveSeparation() {
+    declareAlgorithm("HarmonicPercussiveSeparation");
+    declareInput(_spectrum, TOKEN, "spectrum");
+    declareOutput(_harmonicSpectrum, TOKEN, "harmonicSpectrum");
+    declareOutput(_harmonicRatio, TOKEN, "harmonicRatio");
+  }
+};
+
+} // namespace streaming
+} // namespace essentia
+
+#endif // ESSENTIA_HARMONICPERCUSSIVESEPARATION_H
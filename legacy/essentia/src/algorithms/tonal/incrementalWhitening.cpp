@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "incrementalWhitening.h"
+#include "essentiamath.h"
+
+using namespace std;
+
+namespace essentia {
+namespace standard {
+
+const char* IncrementalWhitening::name = "IncrementalWhitening";
+const char* IncrementalWhitening::category = "Spectral";
+const char* IncrementalWhitening::description = DOC("This algorithm performs spectral whitening of spectral peaks like SpectralWhitening, but keeps the spectral envelope across frames instead of estimating it from scratch for every frame.\n"
+"\n"
+"The envelope is the maximum magnitude, in dB, of every band of bandWidth Hz up to maxFrequency. It is re-estimated on the first frame and then once every 'decimation' frames, and every new estimate is merged into the current one with a first order recursive filter: envelope = smoothing * envelope + (1 - smoothing) * estimate. On the other frames the spectrum input is not read. Peak magnitudes are divided by the envelope, linearly interpolated between band centres, at the peak frequency. Peaks above maxFrequency are not modified.\n"
+"\n"
+"For stationary material such as electronic dance music the envelope changes slowly, so the per-frame cost drops to a lookup for every peak, with results close to SpectralWhitening. The output only depends on the frames processed since the last reset, so reset must be called between tracks.\n"
+"\n"
+"IncrementalWhitening will throw an exception when the frequencies and magnitudes of the peaks have different sizes, or when the spectrum is empty on a frame where the envelope is updated.");
+
+
+void IncrementalWhitening::configure() {
+  _maxFrequency = parameter("maxFrequency").toReal();
+  _sampleRate = parameter("sampleRate").toReal();
+  _bandWidth = parameter("bandWidth").toReal();
+  _smoothing = parameter("smoothing").toReal();
+  _decimation = parameter("decimation").toInt();
+
+  if (_maxFrequency > _sampleRate / 2.0) {
+    throw EssentiaException("IncrementalWhitening: maxFrequency must not be higher than the Nyquist frequency");
+  }
+
+  reset();
+}
+
+
+void IncrementalWhitening::reset() {
+  _envelope.clear();
+  _frame = 0;
+}
+
+
+void IncrementalWhitening::updateEnvelope(const vector<Real>& spectrum) {
+  int spectrumSize = (int)spectrum.size();
+  if (spectrumSize < 2) {
+    throw EssentiaException("IncrementalWhitening: the input spectrum is empty");
+  }
+
+  int nBands = (int)ceil(_maxFrequency / _bandWidth);
+  Real binWidth = _sampleRate / (2.0 * (spectrumSize - 1));
+
+  vector<Real> bandMax(nBands, (Real)0.0);
+  for (int k=0; k<spectrumSize; k++) {
+    Real freq = k * binWidth;
+    if (freq > _maxFrequency) break;
+    int band = min((int)(freq / _bandWidth), nBands - 1);
+    if (spectrum[k] > bandMax[band]) bandMax[band] = spectrum[k];
+  }
+
+  if (_envelope.empty()) {
+    _envelope.resize(nBands);
+    for (int b=0; b<nBands; b++) _envelope[b] = amp2db(bandMax[b]);
+  }
+  else {
+    for (int b=0; b<nBands; b++) {
+      _envelope[b] = _smoothing * _envelope[b] + (1.0 - _smoothing) * amp2db(bandMax[b]);
+    }
+  }
+}
+
+
+Real IncrementalWhitening::envelopeAt(Real frequency) const {
+  int nBands = (int)_envelope.size();
+  Real position = frequency / _bandWidth - 0.5;  // in bands, from the first centre
+  if (position <= 0) return _envelope[0];
+  if (position >= nBands - 1) return _envelope[nBands - 1];
+  int band = (int)position;
+  Real fraction = position - band;
+  return (1.0 - fraction) * _envelope[band] + fraction * _envelope[band + 1];
+}
+
+
+void IncrementalWhitening::compute() {
+  const vector<Real>& frequencies = _frequencies.get();
+  const vector<Real>& magnitudes = _magnitudes.get();
+  vector<Real>& magnitudesWhite = _magnitudesWhite.get();
+
+  if (frequencies.size() != magnitudes.size()) {
+    throw EssentiaException("IncrementalWhitening: frequency and magnitude input vectors must have the same size");
+  }
+
+  if (_frame % _decimation == 0) {
+    updateEnvelope(_spectrum.get());
+  }
+  _frame = (_frame + 1) % _decimation;
+
+  magnitudesWhite = magnitudes;
+  for (int i=0; i<(int)frequencies.size(); i++) {
+    if (frequencies[i] > _maxFrequency) continue;
+    magnitudesWhite[i] *= db2amp(-envelopeAt(frequencies[i]));
+  }
+}
+
+} // namespace standard
+} // namespace essentia
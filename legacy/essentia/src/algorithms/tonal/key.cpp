@@ -55,8 +55,8 @@ const char* Key::description = DOC("This algorithm computes key estimate given a
 
 
 void Key::configure() {
-  _slope = parameter("slope").toReal();
-  _numHarmonics = parameter("numHarmonics").toInt();
+  _polyphonicProfile.configure(parameter("numHarmonics").toInt(),
+                               parameter("slope").toReal());
   _profileType = parameter("profileType").toString();
 
   const char* keyNames[] = { "A", "A#", "B", "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#" };
@@ -142,8 +142,7 @@ void Key::configure() {
   }
 
   // Compute the other vectors getting into account chords:
-  vector<Real> M_chords(12, (Real)0.0);
-  vector<Real> m_chords(12, (Real)0.0);
+  PolyphonicProfile& chords = _polyphonicProfile;
 
   /* Under test: Purwins et al.
   for (int n=0; n<12; n++) {
@@ -177,69 +176,75 @@ void Key::configure() {
   */
 
   /** MAJOR KEY */
+  chords.clear();
   // Tonic (I)
-  addMajorTriad(0, _M[0], M_chords);
+  chords.addMajorTriad(0, _M[0]);
 
   if (!parameter("useThreeChords").toBool())
   {
     // II
-    addMinorTriad(2, _M[2], M_chords);
+    chords.addMinorTriad(2, _M[2]);
     // Only root: AddContributionHarmonics(2, _M[2], M_chords);
     // III
-    addMinorTriad(4, _M[4], M_chords);
+    chords.addMinorTriad(4, _M[4]);
     // Only root: AddContributionHarmonics(4, _M[4], M_chords);
   }
 
   // Subdominant (IV)
-  addMajorTriad(5, _M[5], M_chords);
+  chords.addMajorTriad(5, _M[5]);
   // Dominant (V)
-  addMajorTriad(7, _M[7], M_chords);
+  chords.addMajorTriad(7, _M[7]);
 
   if (!parameter("useThreeChords").toBool()) {
     // VI
-    addMinorTriad(9, _M[9], M_chords);
+    chords.addMinorTriad(9, _M[9]);
     // Only root: AddContributionHarmonics(9, _M[9], M_chords);
     // VII (5th diminished)
-    addContributionHarmonics(11, _M[11], M_chords);
-    addContributionHarmonics(2 , _M[11], M_chords);
-    addContributionHarmonics(5 , _M[11], M_chords);
+    chords.addNote(11, _M[11]);
+    chords.addNote(2 , _M[11]);
+    chords.addNote(5 , _M[11]);
     // Only root: AddContributionHarmonics(11, _M[11], M_chords);
   }
 
+  vector<Real> M_chords = chords.profile();
+
   /** MINOR KEY */
+  chords.clear();
   // Tonica I
-  addMinorTriad(0, _m[0], m_chords);
+  chords.addMinorTriad(0, _m[0]);
   if (!parameter("useThreeChords").toBool()){
     // II (5th diminished)
-    addContributionHarmonics(2, _m[2], m_chords);
-    addContributionHarmonics(5, _m[2], m_chords);
-    addContributionHarmonics(8, _m[2], m_chords);
+    chords.addNote(2, _m[2]);
+    chords.addNote(5, _m[2]);
+    chords.addNote(8, _m[2]);
     // Only root: AddContributionHarmonics(2, _m[2], m_chords);
 
     // III (5th augmented)
-    addContributionHarmonics(3, _m[3], m_chords);
-    addContributionHarmonics(7, _m[3], m_chords);
-    addContributionHarmonics(11,_m[3], m_chords); // Harmonic minor scale! antes 10!!!
+    chords.addNote(3, _m[3]);
+    chords.addNote(7, _m[3]);
+    chords.addNote(11,_m[3]); // Harmonic minor scale! antes 10!!!
     // Only root: AddContributionHarmonics(3, _m[3], m_chords);
   }
 
   // Subdominant (IV)
-  addMinorTriad(5, _m[5], m_chords);
+  chords.addMinorTriad(5, _m[5]);
 
   // Dominant (V) (harmonic minor scale)
-  addMajorTriad(7, _m[7], m_chords);
+  chords.addMajorTriad(7, _m[7]);
 
   if (!parameter("useThreeChords").toBool()) {
     // VI
-    addMajorTriad(8, _m[8], m_chords);
+    chords.addMajorTriad(8, _m[8]);
     // Only root: AddContributionHarmonics(8, _m[8], m_chords);
     // VII (diminished 5th)
-    addContributionHarmonics(11, _m[8], m_chords);
-    addContributionHarmonics(2, _m[8], m_chords);
-    addContributionHarmonics(5, _m[8], m_chords);
+    chords.addNote(11, _m[8]);
+    chords.addNote(2, _m[8]);
+    chords.addNote(5, _m[8]);
     // Only root: AddContributionHarmonics(11, _m[8], m_chords);
   }
 
+  vector<Real> m_chords = chords.profile();
+
   if (parameter("usePolyphony").toBool()) {
     _M = M_chords;
     _m = m_chords;
@@ -444,93 +449,6 @@ Real Key::correlation(const vector<Real>& v1, const Real mean1, const Real std1,
   return r;
 }
 
-/**
-  Each note contribute to the different harmonics:
-  1.- first  harmonic  f   -> i
-  2.- second harmonic  2*f -> i
-  3.- third  harmonic  3*f -> i+7
-  4.- fourth harmonic  4*f -> i
-  ..
-  The contribution is weighted depending of the slope
-*/
-void Key::addContributionHarmonics(const int pitchclass, const Real contribution, vector<Real>& M_chords) const
-{
-  Real weight = contribution;
-
-  for (int iHarm = 1; iHarm <= _numHarmonics; iHarm++) {
-
-    Real index  = pitchclass + 12*log2((Real)iHarm);
-
-    Real before = floor(index);
-    Real after  = ceil (index);
-
-    int ibefore= (int) fmod((Real)before,(Real)12.0);
-    int iafter = (int) fmod((Real)after ,(Real)12.0);
-
-    // weight goes proportionally to ibefore & iafter
-    if (ibefore < iafter) {
-      Real distance_before = index-before;
-      M_chords[ibefore] += pow(cos(0.5*M_PI*distance_before),2)*weight;
-
-      Real distance_after  = after-index;
-      M_chords[iafter ] += pow(cos(0.5*M_PI*distance_after ),2)*weight;
-    }
-    else { // equal
-      M_chords[ibefore] += weight;
-    }
-    weight *= _slope;
-  }
-}
-
-/**
-  Function that adds the contribution of a chord with root note 'root' to its major triad
-  A major triad includes notes from three different classes of pitch: the root, the major 3rd and perfect 5th.
-  This is the most relaxed, most consonant chord in all of harmony.
-  @see http://www.songtrellis.com/directory/1146/chordTypes/majorChordTypes/majorTriad
-  The three notes of the chord have the same weight
-*/
-void Key::addMajorTriad(const int root, const Real contribution, vector<Real>& M_chords) const
-{
-  // Root
-  addContributionHarmonics(root, contribution, M_chords);
-
-  // Major 3rd
-  int third = root + 4;
-  if (third > 11)
-    third -= 12;
-  addContributionHarmonics(third, contribution, M_chords);
-
-  // Perfect 5th
-  int fifth = root + 7;
-  if (fifth > 11)
-    fifth -= 12;
-  addContributionHarmonics(fifth, contribution, M_chords);
-
-}
-/**
-  Function that adds the contribution of a chord with root note 'root' to its minor triad
-  A minor triad includes notes from three different classes of pitch: the root, the minor 3rd and perfect 5th.
-  @see http://www.songtrellis.com/directory/1146/chordTypes/minorChordTypes/minorTriadMi
-  The three notes of the chord have the same weight
-*/
-void Key::addMinorTriad(int root, Real contribution, vector<Real>& M_chords) const
-{
-  // Root
-  addContributionHarmonics(root, contribution, M_chords);
-
-  // Minor 3rd
-  int third = root+3;
-  if (third > 11)
-    third -= 12;
-  addContributionHarmonics(third, contribution, M_chords);
-
-  // Perfect 5th
-  int fifth = root+7;
-  if (fifth > 11)
-    fifth -= 12;
-  addContributionHarmonics(fifth, contribution, M_chords);
-}
-
 } // namespace standard
 } // namespace essentia
 
@@ -21,6 +21,7 @@
 #define ESSENTIA_KEY_H
 
 #include "algorithm.h"
+#include "polyphonicProfile.h"
 
 namespace essentia {
 namespace standard {
@@ -77,16 +78,12 @@ protected:
   Real _std_profile_M;
   Real _std_profile_m;
 
-  Real _slope;
-  int _numHarmonics;
+  PolyphonicProfile _polyphonicProfile;
   std::string _profileType;
 
   std::vector<std::string> _keys;
 
   Real correlation(const std::vector<Real>& v1, const Real mean1, const Real std1, const std::vector<Real>& v2, const Real mean2, const Real std2, const int shift) const;
-  void addContributionHarmonics(const int pitchclass, const Real contribution, std::vector<Real>& M_chords) const;
-  void addMajorTriad(const int root, const Real contribution, std::vector<Real>& M_chords) const;
-  void addMinorTriad(int root, Real contribution, std::vector<Real>& M_chords) const;
   void resize(int size);
 };
 
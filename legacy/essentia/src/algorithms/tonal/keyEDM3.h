@@ -21,6 +21,9 @@
 #define ESSENTIA_KEYEDM3_H
 
 #include "algorithm.h"
+#include "keyEstimator.h"
+#include "keyProfiles.h"
+#include "pcpSalience.h"
 
 namespace essentia {
 namespace standard {
@@ -34,23 +37,33 @@ class KeyEDM3 : public Algorithm {
   Output<std::string> _scale;
   Output<Real> _strength;
   Output<Real> _firstToSecondRelativeStrength;
+  Output<Real> _tuningOffset;
+  Output<Real> _probability;
 
  public:
 
-  KeyEDM3() {
+  KeyEDM3() : _estimator(0) {
     declareInput(_pcp, "pcp", "the input pitch class profile");
 
     declareOutput(_key, "key", "the estimated key, from A to G");
     declareOutput(_scale, "scale", "the scale of the key (major or minor)");
     declareOutput(_strength, "strength", "the strength of the estimated key");
     declareOutput(_firstToSecondRelativeStrength, "firstToSecondRelativeStrength", "the relative strength difference between the best estimate and second best estimate of the key");
+    declareOutput(_tuningOffset, "tuningOffset", "the estimated deviation of the input pcp from equal temperament, in cents");
+    declareOutput(_probability, "probability", "the calibrated probability of the estimated key (tonic and scale), from the correlations with every profile at every shift");
   }
 
   void declareParameters() {
     declareParameter("profileType", "the type of polyphic profile to use for correlation calculation", "{bgate,braw,edma}", "bgate");
+    declareParameter("profileFile", "a key profile file (see keyProfiles.h) to use instead of profileType. Its mode labels are used as scales, except 'other', reported as minor. The mode labelled 'minor', if any, wins exact ties", "", "");
     declareParameter("pcpSize", "number of divisions per octave (12*i). This parameter is only a hint; During computation the size of the input PCP is used instead)", "[12,inf)", 36);
+    declareParameter("twoStage", "fold the input pcp into 12 bins around its estimated tuning and correlate only the 12 semitone shifts, instead of interpolating the profiles to the pcp size", "{true,false}", false);
+    declareParameter("quantized", "quantize the pcp and the profiles to 8 bits and correlate them with integer arithmetic", "{true,false}", false);
+    declareParameter("temperature", "the softmax temperature of the key probability, to be fitted on annotated data (see templates.fit_key_temperature)", "(0,inf)", 0.05);
   }
 
+  ~KeyEDM3();
+
   void compute();
   void configure();
 
@@ -59,33 +72,17 @@ class KeyEDM3 : public Algorithm {
   static const char* description;
 
 protected:
-  enum Scales {
-    MAJOR   = 0,
-    MINOR   = 1,
-    OTHER   = 2,
-  };
-
-  std::vector<Real> _M;
-  std::vector<Real> _m;
-  std::vector<Real> _O;
-
-  std::vector<Real> _profile_doM;
-  std::vector<Real> _profile_dom;
-  std::vector<Real> _profile_doO;
-
-  Real _mean_profile_M;
-  Real _mean_profile_m;
-  Real _mean_profile_O;
-
-  Real _std_profile_M;
-  Real _std_profile_m;
-  Real _std_profile_O;
+  KeyProfileSet _profileSet;
 
   std::string _profileType;
+  bool _twoStage;
+  bool _quantized;
+  Real _temperature;
+
+  KeyEstimator* _estimator;
 
   std::vector<std::string> _keys;
 
-  Real correlation(const std::vector<Real>& v1, const Real mean1, const Real std1, const std::vector<Real>& v2, const Real mean2, const Real std2, const int shift) const;
   void resize(int size);
 };
 
@@ -110,18 +107,30 @@ class KeyEDM3 : public AlgorithmComposite {
   Algorithm* _poolStorage;
   standard::Algorithm* _keyEDM3Algo;
 
+  PcpWeighting _frameWeighting;
+
  public:
   KeyEDM3();
   ~KeyEDM3();
 
   void declareParameters() {
     declareParameter("profileType", "the type of polyphic profile to use for correlation calculation", "{bgate,braw,edma}", "bgate");
+    declareParameter("profileFile", "a key profile file (see keyProfiles.h) to use instead of profileType. Its mode labels are used as scales, except 'other', reported as minor. The mode labelled 'minor', if any, wins exact ties", "", "");
     declareParameter("pcpSize", "number of divisions per octave (12*i). This parameter is only a hint; During computation the size of the input PCP is used instead)", "[12,inf)", 36);
+    declareParameter("twoStage", "fold the input pcp into 12 bins around its estimated tuning and correlate only the 12 semitone shifts, instead of interpolating the profiles to the pcp size", "{true,false}", false);
+    declareParameter("quantized", "quantize the pcp and the profiles to 8 bits and correlate them with integer arithmetic", "{true,false}", false);
+    declareParameter("temperature", "the softmax temperature of the key probability, to be fitted on annotated data (see templates.fit_key_temperature)", "(0,inf)", 0.05);
+    declareParameter("frameWeighting", "the weight of every frame in the summed pcp: none or its tonal salience, from its peakiness or its entropy (see PcpAccumulator)", "{none,peakiness,entropy}", "none");
   }
 
   void configure() {
     _keyEDM3Algo->configure(INHERIT("profileType"),
-                            INHERIT("pcpSize"));
+                            INHERIT("profileFile"),
+                            INHERIT("pcpSize"),
+                            INHERIT("twoStage"),
+                            INHERIT("quantized"),
+                            INHERIT("temperature"));
+    _frameWeighting = pcpWeighting(parameter("frameWeighting").toString());
   }
 
   void declareProcessOrder() {
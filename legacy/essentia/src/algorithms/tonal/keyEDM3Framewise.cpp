@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "keyEDM3Framewise.h"
+#include "keyProfiles.h"
+
+using namespace std;
+
+namespace essentia {
+namespace standard {
+
+const char* KeyEDM3Framewise::name = "KeyEDM3Framewise";
+const char* KeyEDM3Framewise::category = "Tonal";
+const char* KeyEDM3Framewise::description = DOC("This algorithm computes the strength of every key in every frame of a chromagram, using the profiles of KeyEDM3. For each frame, the strength of a key is the best correlation of the corresponding profile (major, minor or other) over the shifts of its tonic, as in KeyEDM3, so the output has 36 values per frame. With a profile file (see keyProfiles.h) there are 12 values per mode of the file.\n"
+"\n"
+"The whole chromagram is matched in one call, as a blocked matrix product between the frames and a table of the profiles at every shift, which is much faster than running KeyEDM3 on every frame.\n"
+"\n"
+"KeyEDM3Framewise will throw an exception when the input pcp size is not a positive multiple of 12 or when the frames do not all have the same size.");
+
+
+KeyEDM3Framewise::~KeyEDM3Framewise() {
+  delete _matcher;
+}
+
+
+void KeyEDM3Framewise::configure() {
+  string profileType = parameter("profileType").toString();
+  string profileFile = parameter("profileFile").toString();
+
+  if (!profileFile.empty()) {
+    _profiles = loadProfileSet(profileFile).profiles;
+  }
+  else {
+    _profiles.resize(3);
+    if (!edm3Profiles(profileType, _profiles[0], _profiles[1], _profiles[2])) {
+      throw EssentiaException("KeyEDM3Framewise: Unsupported profile type: ", profileType);
+    }
+  }
+
+  // the matcher of the previous profiles is dropped. pcpSize is only a
+  // hint: if it is not a multiple of 12, the matcher is built for the size
+  // of the first input pcps instead
+  delete _matcher;
+  _matcher = 0;
+  int pcpSize = parameter("pcpSize").toInt();
+  if (pcpSize % 12 == 0) {
+    resize(pcpSize);
+  }
+}
+
+
+// the current matcher is only replaced once the new one has been built
+
+void KeyEDM3Framewise::resize(int pcpSize) {
+  KeyMatcher* matcher = new KeyMatcher(_profiles, pcpSize);
+  delete _matcher;
+  _matcher = matcher;
+}
+
+
+void KeyEDM3Framewise::compute() {
+
+  const vector<vector<Real> >& pcp = _pcp.get();
+  vector<vector<Real> >& keyStrengths = _keyStrengths.get();
+
+  int frames = (int)pcp.size();
+  keyStrengths.resize(frames);
+  if (frames == 0) return;
+
+  int pcpsize = (int)pcp[0].size();
+
+  if (pcpsize < 12 || pcpsize % 12 != 0)
+    throw EssentiaException("KeyEDM3Framewise: input PCP size is not a positive multiple of 12");
+
+  if (!_matcher || pcpsize != _matcher->pcpSize()) {
+    resize(pcpsize);
+  }
+
+  // copy the frames into one contiguous matrix
+  _chroma.resize(frames * pcpsize);
+  for (int f=0; f<frames; f++) {
+    if ((int)pcp[f].size() != pcpsize)
+      throw EssentiaException("KeyEDM3Framewise: all the input pcps must have the same size");
+    copy(pcp[f].begin(), pcp[f].end(), _chroma.begin() + f*pcpsize);
+  }
+
+  int rows = _matcher->numProfiles() * pcpsize;
+  _scores.resize(frames * rows);
+  _matcher->correlateFrames(&_chroma[0], frames, &_scores[0]);
+
+  for (int f=0; f<frames; f++) {
+    keyStrengths[f].resize(_matcher->numProfiles() * 12);
+    _matcher->keyScores(&_scores[f*rows], &keyStrengths[f][0]);
+  }
+}
+
+} // namespace standard
+} // namespace essentia
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_KEYEDM3FRAMEWISE_H
+#define ESSENTIA_KEYEDM3FRAMEWISE_H
+
+#include "algorithm.h"
+#include "keyMatcher.h"
+
+namespace essentia {
+namespace standard {
+
+class KeyEDM3Framewise : public Algorithm {
+
+ private:
+  Input<std::vector<std::vector<Real> > > _pcp;
+  Output<std::vector<std::vector<Real> > > _keyStrengths;
+
+ public:
+
+  KeyEDM3Framewise() : _matcher(0) {
+    declareInput(_pcp, "pcp", "the frame-wise pitch class profiles (frames x pcpSize)");
+    declareOutput(_keyStrengths, "keyStrengths", "the strength of every key in every frame (frames x 12 per mode): with the built-in profiles, the 12 major keys, the 12 minor keys and the 12 'other' keys, from A to G#");
+  }
+
+  ~KeyEDM3Framewise();
+
+  void declareParameters() {
+    declareParameter("profileType", "the type of polyphic profile to use for correlation calculation", "{bgate,braw,edma}", "bgate");
+    declareParameter("profileFile", "a key profile file (see keyProfiles.h) to use instead of profileType", "", "");
+    declareParameter("pcpSize", "number of divisions per octave (12*i). This parameter is only a hint; During computation the size of the input PCP is used instead)", "[12,inf)", 36);
+  }
+
+  void compute();
+  void configure();
+
+  static const char* name;
+  static const char* category;
+  static const char* description;
+
+protected:
+  std::vector<std::vector<Real> > _profiles;
+  KeyMatcher* _matcher;
+
+  // frames x pcpSize input and frames x (3 * pcpSize) correlations
+  std::vector<Real> _chroma;
+  std::vector<Real> _scores;
+
+  void resize(int pcpSize);
+};
+
+} // namespace standard
+} // namespace essentia
+
+#endif // ESSENTIA_KEYEDM3FRAMEWISE_H
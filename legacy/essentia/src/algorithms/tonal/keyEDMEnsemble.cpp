@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "keyEDMEnsemble.h"
+#include <algorithm>
+#include "essentiamath.h"
+
+using namespace std;
+
+namespace essentia {
+namespace standard {
+
+const char* KeyEDMEnsemble::name = "KeyEDMEnsemble";
+const char* KeyEDMEnsemble::category = "Tonal";
+const char* KeyEDMEnsemble::description = DOC("This algorithm gives the results of KeyEDM3 and KeyExtended on the same pcp, and the key obtained by fusing them, in a single pass.\n"
+"\n"
+"The primary profiles (those of KeyEDM3, or a profile file) and the modal profiles of KeyExtended are correlated with the pcp together: the pcp is centred and normalized once, and the correlations with every profile at every shift are computed at once by a KeyMatcher. The primary key and scale are chosen as in KeyEDM3, and the modal ones are the best modal profile (the first one on exact ties).\n"
+"\n"
+"With the modalOverride fusion, the scale becomes overrideScale when the modal estimation is one of overrideModes and has the same tonic as the primary one. The defaults assign monotonic tracks to minor, as done by the key extractors of the EDM key scripts.\n"
+"\n"
+"The probability output is the one of KeyEDM3, over the primary profiles.\n"
+"\n"
+"KeyEDMEnsemble will throw an exception when the input pcp size is not a positive multiple of 12, or when the pcp is flat or silent and has no key.\n"
+"\n"
+"References:\n"
+"  [1] Á. Faraldo, E. Gómez, S. Jordà, P.Herrera, \"Key Estimation in Electronic\n"
+"  Dance Music. Proceedings of the 38th International Conference on information\n"
+"  Retrieval, Padova, 2016.");
+
+
+KeyEDMEnsemble::~KeyEDMEnsemble() {
+  delete _matcher;
+}
+
+
+void KeyEDMEnsemble::configure() {
+
+  const char* keyNames[] = { "A", "Bb", "B", "C", "C#", "D", "Eb", "E", "F", "F#", "G", "Ab" };
+  _keys = arrayToVector<string>(keyNames);
+
+  string profileType = parameter("profileType").toString();
+  string profileFile = parameter("profileFile").toString();
+
+  KeyProfileSet primary;
+  if (!profileFile.empty()) {
+    primary = loadProfileSet(profileFile);
+  }
+  else if (!edm3ProfileSet(profileType, primary)) {
+    throw EssentiaException("KeyEDMEnsemble: Unsupported profile type: ", profileType);
+  }
+
+  KeyProfileSet modal;
+  extendedProfileSet(modal);
+
+  _primaryScales.resize(primary.numModes());
+  for (int p=0; p<primary.numModes(); p++) {
+    _primaryScales[p] = reportedScale(primary.labels[p]);
+  }
+  _tieMode = primary.modeIndex("minor");
+  _modalLabels = modal.labels;
+  _profiles = primary.profiles;
+  _profiles.insert(_profiles.end(), modal.profiles.begin(), modal.profiles.end());
+
+  _temperature = parameter("temperature").toReal();
+  _modalOverride = parameter("fusion").toString() == "modalOverride";
+  _overrideModes = parameter("overrideModes").toVectorString();
+  _overrideScale = parameter("overrideScale").toString();
+
+  // the matcher of the previous profiles is dropped. pcpSize is only a
+  // hint: if it is not a multiple of 12, the matcher is built for the size
+  // of the first input pcp instead
+  delete _matcher;
+  _matcher = 0;
+  int pcpSize = parameter("pcpSize").toInt();
+  if (pcpSize % 12 == 0) {
+    resize(pcpSize);
+  }
+}
+
+
+// the current matcher is only replaced once the new one has been built
+
+void KeyEDMEnsemble::resize(int pcpSize) {
+  KeyMatcher* matcher = new KeyMatcher(_profiles, pcpSize);
+  delete _matcher;
+  _matcher = matcher;
+}
+
+
+void KeyEDMEnsemble::compute() {
+
+  const vector<Real>& pcp = _pcp.get();
+
+  int pcpsize = (int)pcp.size();
+
+  if (pcpsize < 12 || pcpsize % 12 != 0)
+    throw EssentiaException("KeyEDMEnsemble: input PCP size is not a positive multiple of 12");
+
+  if (!_matcher || pcpsize != _matcher->pcpSize()) {
+    resize(pcpsize);
+  }
+
+  int numProfiles = _matcher->numProfiles();
+  int numPrimary = (int)_primaryScales.size();
+
+  _scores.resize(numProfiles * pcpsize);
+  _matcher->correlate(&pcp[0], &_scores[0]);
+
+  // maximum of every profile and, as in the Key* algorithms, the maximum
+  // found before it
+  vector<Real> maxima(numProfiles, -1);
+  vector<Real> secondMaxima(numProfiles, -1);
+  vector<int> keyIndices(numProfiles, -1);
+
+  for (int p=0; p<numProfiles; p++) {
+    const Real* row = &_scores[p*pcpsize];
+    for (int shift=0; shift<pcpsize; shift++) {
+      if (row[shift] > maxima[p]) {
+        secondMaxima[p] = maxima[p];
+        maxima[p] = row[shift];
+        keyIndices[p] = shift;
+      }
+    }
+  }
+
+  // primary estimation, with the decision of KeyEDM3: the minor profile
+  // wins exact ties
+  int primary = 0;
+  for (int p=1; p<numPrimary; p++) {
+    if (maxima[p] > maxima[primary]) primary = p;
+  }
+  if (_tieMode >= 0 && maxima[_tieMode] >= maxima[primary]) {
+    primary = _tieMode;
+  }
+
+  int modal = numPrimary;
+  for (int p=numPrimary+1; p<numProfiles; p++) {
+    if (maxima[p] > maxima[modal]) modal = p;
+  }
+
+  if (keyIndices[primary] < 0 || keyIndices[modal] < 0) {
+    throw EssentiaException("KeyEDMEnsemble: keyIndex smaller than zero. Could not find key.");
+  }
+
+  // only flat (or silent) pcps have no positive correlation, see KeyEstimator
+  if (maxima[primary] <= 0) {
+    throw EssentiaException("KeyEDMEnsemble: the pcp is flat or silent. Could not find key.");
+  }
+
+  int keyIndex = (int) (keyIndices[primary] * 12 / pcpsize + 0.5);
+  int modalKeyIndex = (int) (keyIndices[modal] * 12 / pcpsize + 0.5);
+
+  _probabilities.resize(numPrimary * 12);
+  _matcher->keyProbabilities(&_scores[0], numPrimary, _temperature, &_probabilities[0]);
+
+  // the 'other' profile of the EDM sets is reported as minor
+  const string& primaryScale = _primaryScales[primary];
+  const string& modalScale = _modalLabels[modal - numPrimary];
+
+  string scale = primaryScale;
+  if (_modalOverride && modalKeyIndex == keyIndex &&
+      find(_overrideModes.begin(), _overrideModes.end(), modalScale) != _overrideModes.end()) {
+    scale = _overrideScale;
+  }
+
+  _key.get() = _keys[keyIndex % 12];
+  _scale.get() = scale;
+  _strength.get() = maxima[primary];
+  _firstToSecondRelativeStrength.get() = (maxima[primary] - secondMaxima[primary]) / maxima[primary];
+  // probability of the primary key over all the profiles reported with its
+  // scale, e.g. minor and other
+  Real probability = 0;
+  for (int p=0; p<numPrimary; p++) {
+    if (_primaryScales[p] == primaryScale) probability += _probabilities[p*12 + keyIndex % 12];
+  }
+  _probability.get() = probability;
+  _primaryScale.get() = primaryScale;
+  _modalKey.get() = _keys[modalKeyIndex % 12];
+  _modalScale.get() = modalScale;
+  _modalStrength.get() = maxima[modal];
+}
+
+} // namespace standard
+} // namespace essentia
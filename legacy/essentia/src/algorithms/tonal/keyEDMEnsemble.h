@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_KEYEDMENSEMBLE_H
+#define ESSENTIA_KEYEDMENSEMBLE_H
+
+#include "algorithm.h"
+#include "keyMatcher.h"
+#include "keyProfiles.h"
+
+namespace essentia {
+namespace standard {
+
+class KeyEDMEnsemble : public Algorithm {
+
+ private:
+  Input<std::vector<Real> > _pcp;
+
+  Output<std::string> _key;
+  Output<std::string> _scale;
+  Output<Real> _strength;
+  Output<Real> _firstToSecondRelativeStrength;
+  Output<Real> _probability;
+  Output<std::string> _primaryScale;
+  Output<std::string> _modalKey;
+  Output<std::string> _modalScale;
+  Output<Real> _modalStrength;
+
+ public:
+
+  KeyEDMEnsemble() : _matcher(0) {
+    declareInput(_pcp, "pcp", "the input pitch class profile");
+
+    declareOutput(_key, "key", "the estimated key, from A to G");
+    declareOutput(_scale, "scale", "the scale of the key, after fusing the primary and modal estimations");
+    declareOutput(_strength, "strength", "the strength of the primary estimation");
+    declareOutput(_firstToSecondRelativeStrength, "firstToSecondRelativeStrength", "the relative strength difference between the best estimate and second best estimate of the primary key");
+    declareOutput(_probability, "probability", "the calibrated probability of the primary key, from the correlations with every primary profile at every shift");
+    declareOutput(_primaryScale, "primaryScale", "the scale of the primary estimation, as given by KeyEDM3");
+    declareOutput(_modalKey, "modalKey", "the tonic of the modal estimation, from A to G");
+    declareOutput(_modalScale, "modalScale", "the mode of the modal estimation, as given by KeyExtended");
+    declareOutput(_modalStrength, "modalStrength", "the strength of the modal estimation");
+  }
+
+  ~KeyEDMEnsemble();
+
+  void declareParameters() {
+    const char* overrideModes[] = { "monotonic" };
+    declareParameter("profileType", "the primary profiles, as in KeyEDM3", "{bgate,braw,edma}", "bgate");
+    declareParameter("profileFile", "a key profile file (see keyProfiles.h) to use as primary profiles instead of profileType, as in KeyEDM3", "", "");
+    declareParameter("pcpSize", "number of divisions per octave (12*i). This parameter is only a hint; During computation the size of the input PCP is used instead)", "[12,inf)", 36);
+    declareParameter("temperature", "the softmax temperature of the key probability, as in KeyEDM3", "(0,inf)", 0.05);
+    declareParameter("fusion", "how the scale is chosen: the primary scale, or overrideScale when the modal estimation is one of overrideModes on the same tonic", "{primary,modalOverride}", "modalOverride");
+    declareParameter("overrideModes", "the modal estimations that override the primary scale", "", arrayToVector<std::string>(overrideModes));
+    declareParameter("overrideScale", "the scale given to the tracks with an overriding modal estimation", "", "minor");
+  }
+
+  void compute();
+  void configure();
+
+  static const char* name;
+  static const char* category;
+  static const char* description;
+
+protected:
+  std::vector<std::string> _primaryScales;  // the scale reported for every primary profile
+  int _tieMode;  // the primary minor profile, which wins exact ties, -1 if none
+  std::vector<std::string> _modalLabels;
+  std::vector<std::vector<Real> > _profiles;  // the primary profiles, then the modal ones
+
+  Real _temperature;
+  bool _modalOverride;
+  std::vector<std::string> _overrideModes;
+  std::string _overrideScale;
+
+  KeyMatcher* _matcher;
+  std::vector<Real> _scores;
+  std::vector<Real> _probabilities;
+
+  std::vector<std::string> _keys;
+
+  void resize(int pcpSize);
+};
+
+} // namespace standard
+} // namespace essentia
+
+#endif // ESSENTIA_KEYEDMENSEMBLE_H
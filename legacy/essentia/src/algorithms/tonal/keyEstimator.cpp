@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "keyEstimator.h"
+#include "pcpTuning.h"
+
+using namespace std;
+
+namespace essentia {
+
+KeyEstimator::KeyEstimator(const KeyProfileSet& profileSet,
+                           int pcpSize, bool twoStage, bool quantized, Real temperature) :
+    _twoStage(twoStage), _quantized(quantized), _temperature(temperature),
+    _tieMode(profileSet.modeIndex("minor")),
+    _matcher(profileSet.profiles, twoStage ? 12 : pcpSize, !quantized) {
+
+  const vector<vector<Real> >& profiles = profileSet.profiles;
+
+  if (profiles.empty())
+    throw EssentiaException("KeyEstimator: at least one key profile is needed");
+
+  if (temperature <= 0)
+    throw EssentiaException("KeyEstimator: the temperature must be positive");
+
+  if (profileSet.labels.size() != profiles.size())
+    throw EssentiaException("KeyEstimator: every key profile needs a label");
+
+  _reportedModes.resize(profiles.size());
+  for (int p=0; p<(int)profiles.size(); p++) {
+    string scale = reportedScale(profileSet.labels[p]);
+    _reportedModes[p] = p;
+    for (int other=0; other<p; other++) {
+      if (reportedScale(profileSet.labels[other]) == scale) {
+        _reportedModes[p] = other;
+        break;
+      }
+    }
+  }
+
+  if (_quantized) {
+    _qprofiles.resize(profiles.size());
+    for (int p=0; p<(int)profiles.size(); p++) {
+      quantizePcp(KeyMatcher::interpolate(profiles[p], _matcher.pcpSize()), _qprofiles[p]);
+    }
+  }
+}
+
+
+bool KeyEstimator::accepts(int pcpSize) const {
+  if (pcpSize < 12 || pcpSize % 12 != 0) return false;
+  return _twoStage || pcpSize == _matcher.pcpSize();
+}
+
+
+KeyEstimate KeyEstimator::estimate(const vector<Real>& input) const {
+
+  int inputsize = (int)input.size();
+
+  if (inputsize < 12 || inputsize % 12 != 0)
+    throw EssentiaException("KeyEstimator: input PCP size is not a positive multiple of 12");
+
+  if (!accepts(inputsize))
+    throw EssentiaException("KeyEstimator: input PCP size does not match the size of the profiles");
+
+  KeyEstimate result;
+
+  // Tuning, in bins of the input pcp
+  Real tuning = estimatePcpTuning(input);
+  result.tuningOffset = tuning * 1200 / inputsize;
+
+  vector<Real> folded;
+  const vector<Real>* pcpToMatch = &input;
+  if (_twoStage && inputsize > 12) {
+    foldPcp(input, tuning, folded);
+    pcpToMatch = &folded;
+  }
+  const vector<Real>& pcp = *pcpToMatch;
+
+  int pcpsize = (int)pcp.size();
+  int numProfiles = _matcher.numProfiles();
+
+  // correlation of every profile at every shift
+  vector<Real> scores(numProfiles * pcpsize);
+  if (_quantized) {
+    QuantizedPcp qpcp;
+    quantizePcp(pcp, qpcp);
+    for (int p=0; p<numProfiles; p++) {
+      for (int shift=0; shift<pcpsize; shift++) {
+        scores[p*pcpsize + shift] = correlation(qpcp, _qprofiles[p], shift);
+      }
+    }
+  }
+  else {
+    _matcher.correlate(&pcp[0], &scores[0]);
+  }
+
+  // Compute maximum for every mode. As in the Key* algorithms, the second
+  // maximum is the maximum found before the first one.
+  vector<Real> maxima(numProfiles, -1);
+  vector<Real> secondMaxima(numProfiles, -1);
+  vector<int> keyIndices(numProfiles, -1);
+
+  for (int p=0; p<numProfiles; p++) {
+    const Real* row = &scores[p*pcpsize];
+    for (int shift=0; shift<pcpsize; shift++) {
+      if (row[shift] > maxima[p]) {
+        secondMaxima[p] = maxima[p];
+        maxima[p] = row[shift];
+        keyIndices[p] = shift;
+      }
+    }
+  }
+
+  result.keyScores.resize(numProfiles * 12);
+  _matcher.keyScores(&scores[0], &result.keyScores[0]);
+
+  // With major, minor and other: major wins if it is strictly the best,
+  // minor if it is not worse than the others, other if strictly the best.
+  int scale = 0;
+  for (int p=1; p<numProfiles; p++) {
+    if (maxima[p] > maxima[scale]) scale = p;
+  }
+  if (_tieMode >= 0 && maxima[_tieMode] >= maxima[scale]) {
+    scale = _tieMode;
+  }
+
+  if (keyIndices[scale] < 0) {
+    throw EssentiaException("KeyEstimator: keyIndex smaller than zero. Could not find key.");
+  }
+
+  // The scores of a profile add up to 0 over the shifts, so their maximum
+  // is only 0 when they all are: the pcp is flat (or silent) and has no key.
+  if (maxima[scale] <= 0) {
+    throw EssentiaException("KeyEstimator: the pcp is flat or silent. Could not find key.");
+  }
+
+  result.keyIndex = (int) (keyIndices[scale] * 12 / pcpsize + 0.5);
+  result.scale = scale;
+  result.strength = maxima[scale];
+
+  // relative difference between the maximum and the second highest maximum
+  result.firstToSecondRelativeStrength = (maxima[scale] - secondMaxima[scale]) / maxima[scale];
+
+  // probability of the estimated key from the scores of all the keys, over
+  // all the modes reported with the same scale
+  vector<Real> probabilities(numProfiles * 12);
+  _matcher.keyProbabilities(&scores[0], numProfiles, _temperature, &probabilities[0]);
+  result.probability = 0;
+  for (int p=0; p<numProfiles; p++) {
+    if (_reportedModes[p] == _reportedModes[scale]) {
+      result.probability += probabilities[p*12 + result.keyIndex % 12];
+    }
+  }
+
+  return result;
+}
+
+} // namespace essentia
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_KEYESTIMATOR_H
+#define ESSENTIA_KEYESTIMATOR_H
+
+#include "keyMatcher.h"
+#include "keyProfiles.h"
+#include "pcpQuantization.h"
+
+namespace essentia {
+
+struct KeyEstimate {
+  int keyIndex;   // 0 is A, 1 is Bb, ... as the key names of the Key* algorithms
+  int scale;      // index of the mode in the profiles: MAJOR, MINOR or OTHER with the KeyEDM3 profiles
+  Real strength;
+  Real firstToSecondRelativeStrength;
+  Real tuningOffset;  // in cents
+  Real probability;   // calibrated probability of the estimated tonic and reported scale, see KeyMatcher::keyProbabilities()
+
+  // best correlation of every profile for every tonic, as one row of 12 per
+  // mode, e.g. with the KeyEDM3 profiles (major, minor, other) a
+  // 36-dimensional description of the track for similarity search
+  std::vector<Real> keyScores;
+};
+
+/**
+  The key decision of KeyEDM3 (one profile per mode, usually major, minor and
+  other, optional two-stage folding and quantized correlation) as an
+  immutable object.
+
+  All the profile tables are built in the constructor, and estimate() only
+  uses local storage, so a single instance can be shared by any number of
+  threads without locking. KeyEDM3 is a thin wrapper around it.
+*/
+class KeyEstimator {
+
+ public:
+  enum Scales {
+    MAJOR   = 0,
+    MINOR   = 1,
+    OTHER   = 2,
+  };
+
+  /**
+    'profileSet' holds one 12-bin profile per mode. The estimated mode is
+    the one with the highest correlation; as in the Key* algorithms, the
+    mode labelled minor, if any, wins exact ties, and the first of the
+    others otherwise.
+
+    The probability is the one of the estimated tonic with the reported
+    scale (see reportedScale()): the probabilities of all the modes reported
+    with that scale are added, e.g. those of minor and other with the
+    KeyEDM3 profiles. 'temperature' is the softmax temperature.
+  */
+  KeyEstimator(const KeyProfileSet& profileSet,
+               int pcpSize, bool twoStage, bool quantized, Real temperature);
+
+  int numModes() const { return _matcher.numProfiles(); }
+
+  /**
+    True if estimate() accepts pcps of this size: any multiple of 12 in
+    two-stage mode, pcpSize otherwise.
+  */
+  bool accepts(int pcpSize) const;
+
+  /**
+    Throws an EssentiaException for flat or silent pcps, which correlate
+    with no profile, as the Key* algorithms did through their NaN
+    correlations.
+  */
+  KeyEstimate estimate(const std::vector<Real>& pcp) const;
+
+ protected:
+  bool _twoStage;
+  bool _quantized;
+  Real _temperature;
+  int _tieMode;                    // the minor mode, -1 if none
+  std::vector<int> _reportedModes; // the first mode reported with the scale of every mode
+
+  KeyMatcher _matcher;
+  std::vector<QuantizedPcp> _qprofiles;
+};
+
+} // namespace essentia
+
+#endif // ESSENTIA_KEYESTIMATOR_H
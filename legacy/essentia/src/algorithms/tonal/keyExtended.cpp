@@ -19,6 +19,7 @@
 
 #include "keyExtended.h"
 #include "essentiamath.h"
+#include "keyProfiles.h"
 
 using namespace std;
 
@@ -45,31 +46,22 @@ void KeyExtended::configure() {
   const char* keyNames[] = { "A", "Bb", "B", "C", "C#", "D", "Eb", "E", "F", "F#", "G", "Ab" };
   _keys = arrayToVector<string>(keyNames);
 
-  Real profileTypes[][12] = {
+  KeyProfileSet modal;
+  extendedProfileSet(modal);
 
-//  I     bII   II    bIII  III   IV    #IV   V     bVI   VI    bVII  VII
-  { 1.00, 0.10, 0.43, 0.14, 0.61, 0.38, 0.12, 0.78, 0.13, 0.46, 0.15, 0.60 }, // ionian
-  { 1.00, 0.10, 0.36, 0.37, 0.22, 0.33, 0.18, 0.75, 0.25, 0.18, 0.37, 0.37 }, // harmonic
+  _M1 = modal.profiles[0]; // ionian
+  _m1 = modal.profiles[1]; // harmonic
+  _M2 = modal.profiles[2]; // mixolydian
+  _m2 = modal.profiles[3]; // phrygian
+  _M3 = modal.profiles[4]; // fifth
+  _m3 = modal.profiles[5]; // monotonic
+  _M4 = modal.profiles[6]; // difficult
 
-  { 1.00, 0.10, 0.42, 0.10, 0.55, 0.40, 0.10, 0.77, 0.10, 0.42, 0.66, 0.15 }, // mixolydian
-  { 1.00, 0.47, 0.10, 0.36, 0.24, 0.37, 0.16, 0.76, 0.30, 0.20, 0.45, 0.23 }, // phrygian
-  
-  { 1.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.65, 0.00, 0.00, 0.00, 0.00 }, // fifth
-  { 1.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00 }, // monotonic
-  
-  { 0.80, 0.60, 0.80, 0.60, 0.80, 0.60, 0.80, 0.60, 0.80, 0.60, 0.80, 0.60 }, // difficult
-  { 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00 }, // empty
-
-  { 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00 }, // empty
-  { 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00 }, // empty
-//  I     bII   II    bIII  III   IV    #IV   V     bVI   VI    bVII  VII    
-  
-};
-
-
-#define SET_PROFILE(i) _M1 = arrayToVector<Real>(profileTypes[10*i]); _m1 = arrayToVector<Real>(profileTypes[10*i+1]); _M2 = arrayToVector<Real>(profileTypes[10*i+2]); _m2 = arrayToVector<Real>(profileTypes[10*i+3]); _M3 = arrayToVector<Real>(profileTypes[10*i+4]); _m3 = arrayToVector<Real>(profileTypes[10*i+5]); _M4 = arrayToVector<Real>(profileTypes[10*i+6]); _m4 = arrayToVector<Real>(profileTypes[10*i+7]); _P = arrayToVector<Real>(profileTypes[10*i+8]); _F = arrayToVector<Real>(profileTypes[10*i+9])
+  // empty
+  _m4.assign(12, (Real)0.0);
+  _P.assign(12, (Real)0.0);
+  _F.assign(12, (Real)0.0);
 
-  SET_PROFILE(0);
   resize(parameter("pcpSize").toInt());
 }
 
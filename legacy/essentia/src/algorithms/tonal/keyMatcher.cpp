@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "keyMatcher.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace essentia {
+
+KeyMatcher::KeyMatcher(const vector<vector<Real> >& profiles, int pcpSize, bool tables) :
+    _numProfiles((int)profiles.size()), _pcpSize(pcpSize), _columnStride(0) {
+
+  if (pcpSize < 12 || pcpSize % 12 != 0)
+    throw EssentiaException("KeyMatcher: pcp size is not a positive multiple of 12");
+
+  for (int p=0; p<_numProfiles; p++) {
+    if (profiles[p].size() != 12)
+      throw EssentiaException("KeyMatcher: key profiles must have 12 values");
+  }
+
+  if (!tables) return;
+
+  _rotated.resize(_numProfiles * pcpSize * pcpSize);
+
+  for (int p=0; p<_numProfiles; p++) {
+    vector<Real> profile = interpolate(profiles[p], pcpSize);
+
+    Real mean = 0;
+    for (int i=0; i<pcpSize; i++) mean += profile[i];
+    mean /= pcpSize;
+
+    Real norm = 0;
+    for (int i=0; i<pcpSize; i++) norm += (profile[i] - mean) * (profile[i] - mean);
+    norm = sqrt(norm);
+    if (norm == 0)
+      throw EssentiaException("KeyMatcher: key profiles must not be flat");
+
+    for (int shift=0; shift<pcpSize; shift++) {
+      Real* row = &_rotated[(p*pcpSize + shift) * pcpSize];
+      for (int i=0; i<pcpSize; i++) {
+        int index = i - shift;
+        if (index < 0) index += pcpSize;
+        row[i] = (profile[index] - mean) / norm;
+      }
+    }
+  }
+
+  int rows = _numProfiles * pcpSize;
+  _columnStride = (rows + 7) / 8 * 8;
+  _columns.assign(pcpSize * _columnStride, (Real)0.0);
+  for (int r=0; r<rows; r++) {
+    for (int i=0; i<pcpSize; i++) {
+      _columns[i * _columnStride + r] = _rotated[r * pcpSize + i];
+    }
+  }
+}
+
+vector<Real> KeyMatcher::interpolate(const vector<Real>& P, int pcpSize) {
+  int n = pcpSize/12;
+  vector<Real> profile(pcpSize);
+
+  for (int i=0; i<12; i++) {
+    profile[i*n] = P[i];
+    Real incr = (i == 11) ? (P[11] - P[0]) / n : (P[i] - P[i+1]) / n;
+    for (int j=1; j<=(n-1); j++) {
+      profile[i*n+j] = P[i] - j * incr;
+    }
+  }
+  return profile;
+}
+
+// Norm of a pcp once centred, 0 for flat pcps. A constant pcp leaves a
+// rounding residue instead of an exact 0, so norms that are negligible
+// next to the norm of the pcp itself count as flat.
+static Real centredNorm(const Real* pcp, int size) {
+  Real mean = 0;
+  for (int i=0; i<size; i++) mean += pcp[i];
+  mean /= size;
+
+  Real norm = 0;
+  Real total = 0;
+  for (int i=0; i<size; i++) {
+    norm += (pcp[i] - mean) * (pcp[i] - mean);
+    total += pcp[i] * pcp[i];
+  }
+  if (norm <= 1e-10 * total) return 0;
+  return sqrt(norm);
+}
+
+void KeyMatcher::correlate(const Real* pcp, Real* scores) const {
+  if (_rotated.empty())
+    throw EssentiaException("KeyMatcher: built without correlation tables");
+
+  Real norm = centredNorm(pcp, _pcpSize);
+
+  int rows = _numProfiles * _pcpSize;
+
+  if (norm == 0) {
+    for (int r=0; r<rows; r++) scores[r] = 0;
+    return;
+  }
+
+  // the rows are centred, so the pcp mean does not need to be removed
+  const Real* row = &_rotated[0];
+  for (int r=0; r<rows; r++, row += _pcpSize) {
+    Real dot = 0;
+    for (int i=0; i<_pcpSize; i++) dot += pcp[i] * row[i];
+    scores[r] = dot / norm;
+  }
+}
+
+// number of frames sharing each load of the profile table
+static const int frameBlock = 4;
+
+// out[r] += x * column[r], for n a multiple of 8. The unrolled body and the
+// restrict qualifiers let the compiler use SIMD multiply-adds even at -O2,
+// where loops with an unknown trip count are not vectorized.
+static inline void accumulate(Real x, const Real* __restrict column, Real* __restrict out, int n) {
+  for (int r=0; r<n; r+=8) {
+    out[r+0] += x * column[r+0];
+    out[r+1] += x * column[r+1];
+    out[r+2] += x * column[r+2];
+    out[r+3] += x * column[r+3];
+    out[r+4] += x * column[r+4];
+    out[r+5] += x * column[r+5];
+    out[r+6] += x * column[r+6];
+    out[r+7] += x * column[r+7];
+  }
+}
+
+void KeyMatcher::correlateFrames(const Real* chroma, int frames, Real* scores) const {
+  if (_rotated.empty())
+    throw EssentiaException("KeyMatcher: built without correlation tables");
+
+  int rows = _numProfiles * _pcpSize;
+  vector<Real> sums(frameBlock * _columnStride);
+
+  for (int f0=0; f0<frames; f0+=frameBlock) {
+    int block = frames - f0 < frameBlock ? frames - f0 : frameBlock;
+
+    Real gain[frameBlock];
+    for (int b=0; b<block; b++) {
+      Real norm = centredNorm(chroma + (f0+b)*_pcpSize, _pcpSize);
+
+      // flat pcps get a gain of 0, and so scores of 0
+      gain[b] = norm == 0 ? 0 : 1 / norm;
+    }
+
+    fill(sums.begin(), sums.end(), (Real)0);
+
+    // sums += pcp[i] * column i of the table, for every frame of the block
+    for (int i=0; i<_pcpSize; i++) {
+      const Real* column = &_columns[i * _columnStride];
+      for (int b=0; b<block; b++) {
+        accumulate(chroma[(f0+b)*_pcpSize + i] * gain[b], column, &sums[b * _columnStride], _columnStride);
+      }
+    }
+
+    for (int b=0; b<block; b++) {
+      copy(sums.begin() + b*_columnStride, sums.begin() + b*_columnStride + rows, scores + (f0+b)*rows);
+    }
+  }
+}
+
+void KeyMatcher::bestShifts(const Real* scores, int* shifts) const {
+  for (int p=0; p<_numProfiles; p++) {
+    const Real* row = scores + p*_pcpSize;
+    int best = 0;
+    for (int shift=1; shift<_pcpSize; shift++) {
+      if (row[shift] > row[best]) best = shift;
+    }
+    shifts[p] = best;
+  }
+}
+
+void KeyMatcher::keyScores(const Real* scores, Real* keyScores) const {
+  for (int p=0; p<_numProfiles; p++) {
+    const Real* row = scores + p*_pcpSize;
+    Real* best = keyScores + p*12;
+    for (int tonic=0; tonic<12; tonic++) best[tonic] = -1;
+    for (int shift=0; shift<_pcpSize; shift++) {
+      int tonic = shift * 12 / _pcpSize;
+      if (row[shift] > best[tonic]) best[tonic] = row[shift];
+    }
+  }
+}
+
+void KeyMatcher::keyProbabilities(const Real* scores, int profiles, Real temperature, Real* probabilities) const {
+  int size = profiles * _pcpSize;
+  Real maxScore = *max_element(scores, scores + size);
+
+  for (int i=0; i<profiles*12; i++) probabilities[i] = 0;
+
+  // scores are shifted by their maximum so that exp() cannot overflow
+  double total = 0;
+  for (int p=0; p<profiles; p++) {
+    for (int shift=0; shift<_pcpSize; shift++) {
+      Real weight = exp((scores[p*_pcpSize + shift] - maxScore) / temperature);
+      probabilities[p*12 + shift * 12 / _pcpSize] += weight;
+      total += weight;
+    }
+  }
+
+  for (int i=0; i<profiles*12; i++) probabilities[i] /= total;
+}
+
+} // namespace essentia
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_KEYMATCHER_H
+#define ESSENTIA_KEYMATCHER_H
+
+#include "types.h"
+#include <vector>
+
+namespace essentia {
+
+/**
+  Correlates pitch class profiles of a fixed size against a set of 12-bin key
+  profiles, at every shift, as the Key* algorithms do.
+
+  The profiles are interpolated to pcpSize the same way as in Key::resize(),
+  then centred, divided by their norm and stored once per shift. The
+  correlation of a pcp with profile p at a given shift is then a single dot
+  product divided by the norm of the centred pcp.
+
+  The matcher does not depend on Essentia's Algorithm machinery and works on
+  plain arrays, so it can be called from the python bindings directly on
+  numpy buffers.
+*/
+class KeyMatcher {
+
+ public:
+  /**
+    Without 'tables', only the profiles are checked and the tables of
+    rotated profiles are not built: correlate() and correlateFrames() cannot
+    be called, and the matcher only reduces scores computed elsewhere (see
+    KeyEstimator's quantized mode).
+  */
+  KeyMatcher(const std::vector<std::vector<Real> >& profiles, int pcpSize, bool tables=true);
+
+  /**
+    Linear interpolation of a 12-bin profile to pcpSize bins, as done by the
+    Key* algorithms before correlating.
+  */
+  static std::vector<Real> interpolate(const std::vector<Real>& profile, int pcpSize);
+
+  int numProfiles() const { return _numProfiles; }
+  int pcpSize() const { return _pcpSize; }
+
+  /**
+    Writes the correlation of 'pcp' (pcpSize values) with every profile at
+    every shift into 'scores', as numProfiles rows of pcpSize values.
+    Flat pcps have a correlation of 0 with every profile.
+  */
+  void correlate(const Real* pcp, Real* scores) const;
+
+  /**
+    Same as correlate() for 'frames' consecutive pcps, writing
+    numProfiles*pcpSize scores per frame. The frames are processed as a
+    blocked matrix product with the table of rotated profiles, so that the
+    table is read once for every few frames.
+  */
+  void correlateFrames(const Real* chroma, int frames, Real* scores) const;
+
+  /**
+    Index of the largest value of every row of 'scores' (the first one on
+    ties, as the strict comparison in the Key* algorithms).
+  */
+  void bestShifts(const Real* scores, int* shifts) const;
+
+  /**
+    Reduces the scores of a pcp to the best correlation of every profile for
+    every tonic (the maximum over the shifts of each semitone), as
+    numProfiles rows of 12 values.
+  */
+  void keyScores(const Real* scores, Real* keyScores) const;
+
+  /**
+    Calibrated probability of every tonic of the first 'profiles' profiles,
+    as rows of 12 values: a softmax of their scores, exp(score /
+    temperature) normalised to sum 1, with the shifts of each semitone added
+    together. Unlike the first to second ratio it uses the whole correlation
+    landscape and is bounded, so it can be compared across tracks once the
+    temperature has been fitted on annotated data.
+  */
+  void keyProbabilities(const Real* scores, int profiles, Real temperature, Real* probabilities) const;
+
+ protected:
+  int _numProfiles;
+  int _pcpSize;
+
+  // (numProfiles * pcpSize) rows of pcpSize values: row p*pcpSize + shift
+  // holds profile p, shifted, centred and normalised
+  std::vector<Real> _rotated;
+
+  // the same table transposed, for correlateFrames(): pcpSize rows of
+  // numProfiles * pcpSize values, zero-padded to a multiple of 8
+  int _columnStride;
+  std::vector<Real> _columns;
+};
+
+} // namespace essentia
+
+#endif // ESSENTIA_KEYMATCHER_H
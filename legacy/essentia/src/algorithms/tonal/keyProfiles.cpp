@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "keyProfiles.h"
+#include "essentiamath.h"
+#include "threading.h"
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+namespace essentia {
+
+bool edm3Profiles(const string& profileType, vector<Real>& major, vector<Real>& minor, vector<Real>& other) {
+
+  Real profileTypes[][12] = {
+
+//    I       bII     II      bIII    III     IV      #IV     V       bVI     VI      bVII    VII
+    { 1.00  , 0.00  , 0.42  , 0.00  , 0.53  , 0.37  , 0.00  , 0.77  , 0.00  , 0.38,   0.21  , 0.30   }, // bgate
+    { 1.00  , 0.00  , 0.36  , 0.39  , 0.00  , 0.38  , 0.00  , 0.74  , 0.27  , 0.00  , 0.42  , 0.23   },
+    { 1.00  , 0.26  , 0.35  , 0.29  , 0.44  , 0.36  , 0.21  , 0.78  , 0.26  , 0.25  , 0.32  , 0.26   },
+
+    { 1.0000, 0.1573, 0.4200, 0.1570, 0.5296, 0.3669, 0.1632, 0.7711, 0.1676, 0.3827, 0.2113, 0.2965 }, // braw
+    { 1.0000, 0.2330, 0.3615, 0.3905, 0.2925, 0.3777, 0.1961, 0.7425, 0.2701, 0.2161, 0.4228, 0.2272 },
+    { 1.0000, 0.2608, 0.3528, 0.2935, 0.4393, 0.3580, 0.2137, 0.7809, 0.2578, 0.2539, 0.3233, 0.2615 },
+
+
+    { 1.00  , 0.29  , 0.50  , 0.40  , 0.60  , 0.56  , 0.32  , 0.80  , 0.31  , 0.45  , 0.42  , 0.39   }, // edma
+    { 1.00  , 0.31  , 0.44  , 0.58  , 0.33  , 0.49  , 0.29  , 0.78  , 0.43  , 0.29  , 0.53  , 0.32   },
+    { 1.00  , 0.26  , 0.35  , 0.29  , 0.44  , 0.36  , 0.21  , 0.78  , 0.26  , 0.25  , 0.32  , 0.26   }
+//    I       bII     II      bIII    III     IV      #IV     V       bVI     VI      bVII    VII 
+
+};
+
+#define SET_PROFILE(i) major = arrayToVector<Real>(profileTypes[3*i]); minor = arrayToVector<Real>(profileTypes[3*i+1]); other = arrayToVector<Real>(profileTypes[3*i+2])
+
+  if      (profileType == "bgate")  { SET_PROFILE(0); }
+  else if (profileType == "braw")   { SET_PROFILE(1); }
+  else if (profileType == "edma" )  { SET_PROFILE(2); }
+  else {
+    return false;
+  }
+
+#undef SET_PROFILE
+
+  return true;
+}
+
+
+string reportedScale(const string& label) {
+  return label == "other" ? "minor" : label;
+}
+
+
+bool edm3ProfileSet(const string& profileType, KeyProfileSet& profileSet) {
+  profileSet.profiles.resize(3);
+  if (!edm3Profiles(profileType, profileSet.profiles[0], profileSet.profiles[1], profileSet.profiles[2])) {
+    return false;
+  }
+  const char* labels[] = { "major", "minor", "other" };
+  profileSet.labels = arrayToVector<string>(labels);
+  return true;
+}
+
+
+void extendedProfileSet(KeyProfileSet& profileSet) {
+
+  Real profileTypes[][12] = {
+
+//  I     bII   II    bIII  III   IV    #IV   V     bVI   VI    bVII  VII
+  { 1.00, 0.10, 0.43, 0.14, 0.61, 0.38, 0.12, 0.78, 0.13, 0.46, 0.15, 0.60 }, // ionian
+  { 1.00, 0.10, 0.36, 0.37, 0.22, 0.33, 0.18, 0.75, 0.25, 0.18, 0.37, 0.37 }, // harmonic
+
+  { 1.00, 0.10, 0.42, 0.10, 0.55, 0.40, 0.10, 0.77, 0.10, 0.42, 0.66, 0.15 }, // mixolydian
+  { 1.00, 0.47, 0.10, 0.36, 0.24, 0.37, 0.16, 0.76, 0.30, 0.20, 0.45, 0.23 }, // phrygian
+
+  { 1.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.65, 0.00, 0.00, 0.00, 0.00 }, // fifth
+  { 1.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00 }, // monotonic
+
+  { 0.80, 0.60, 0.80, 0.60, 0.80, 0.60, 0.80, 0.60, 0.80, 0.60, 0.80, 0.60 }  // difficult
+//  I     bII   II    bIII  III   IV    #IV   V     bVI   VI    bVII  VII
+
+};
+
+  const char* labels[] = { "ionian", "harmonic", "mixolydian", "phrygian", "fifth", "monotonic", "difficult" };
+  profileSet.labels = arrayToVector<string>(labels);
+  profileSet.profiles.resize(profileSet.labels.size());
+  for (int m=0; m<(int)profileSet.labels.size(); m++) {
+    profileSet.profiles[m] = arrayToVector<Real>(profileTypes[m]);
+  }
+}
+
+
+static const int maxModes = 256;
+static const int maxLabelLength = 256;
+
+static ForcedMutex profileCacheMutex;
+static map<uint64_t, KeyProfileSet> profileCache;
+
+// 64-bit FNV-1a
+static uint64_t contentHash(const string& data) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i=0; i<(int)data.size(); i++) {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static void parseProfileSet(const string& data, const string& filename, KeyProfileSet& profileSet) {
+  istringstream stream(data);
+
+  char magic[4];
+  uint32_t header[2];
+  stream.read(magic, 4);
+  stream.read((char*)header, sizeof(header));
+  if (!stream || string(magic, 4) != "EDMP" || header[0] != 1) {
+    throw EssentiaException("loadProfileSet: not a key profile file: ", filename);
+  }
+
+  uint32_t numModes = header[1];
+  if (numModes == 0 || numModes > (uint32_t)maxModes) {
+    throw EssentiaException("loadProfileSet: invalid number of modes in ", filename);
+  }
+
+  profileSet.labels.resize(numModes);
+  profileSet.profiles.resize(numModes);
+
+  for (uint32_t m=0; m<numModes; m++) {
+    uint32_t length;
+    stream.read((char*)&length, sizeof(length));
+    if (!stream || length == 0 || length > (uint32_t)maxLabelLength) {
+      throw EssentiaException("loadProfileSet: invalid mode label in ", filename);
+    }
+    string label(length, ' ');
+    stream.read(&label[0], length);
+
+    float values[12];
+    stream.read((char*)values, sizeof(values));
+    if (!stream) {
+      throw EssentiaException("loadProfileSet: truncated key profile file: ", filename);
+    }
+
+    for (uint32_t other=0; other<m; other++) {
+      if (profileSet.labels[other] == label)
+        throw EssentiaException("loadProfileSet: duplicated mode label '" + label + "' in ", filename);
+    }
+
+    Real minimum = values[0];
+    Real maximum = values[0];
+    for (int i=0; i<12; i++) {
+      // also false for NaN
+      if (!(values[i] >= 0 && values[i] <= numeric_limits<float>::max())) {
+        throw EssentiaException("loadProfileSet: profile values must be finite and non-negative, in mode '" + label + "' of ", filename);
+      }
+      minimum = min(minimum, (Real)values[i]);
+      maximum = max(maximum, (Real)values[i]);
+    }
+    if (maximum == minimum) {
+      throw EssentiaException("loadProfileSet: flat profile for mode '" + label + "' in ", filename);
+    }
+
+    profileSet.labels[m] = label;
+    profileSet.profiles[m].resize(12);
+    for (int i=0; i<12; i++) profileSet.profiles[m][i] = values[i] / maximum;
+  }
+
+  if (stream.peek() != EOF) {
+    throw EssentiaException("loadProfileSet: unexpected data at the end of ", filename);
+  }
+}
+
+const KeyProfileSet& loadProfileSet(const string& filename) {
+  ifstream file(filename.c_str(), ios::binary);
+  if (!file) {
+    throw EssentiaException("loadProfileSet: could not open file: ", filename);
+  }
+  ostringstream content;
+  content << file.rdbuf();
+  string data = content.str();
+
+  uint64_t hash = contentHash(data);
+
+  ForcedMutexLocker lock(profileCacheMutex);
+
+  map<uint64_t, KeyProfileSet>::const_iterator cached = profileCache.find(hash);
+  if (cached != profileCache.end()) return cached->second;
+
+  KeyProfileSet profileSet;
+  parseProfileSet(data, filename, profileSet);
+  return profileCache[hash] = profileSet;
+}
+
+void writeProfileSet(const string& filename, const KeyProfileSet& profileSet) {
+  if (profileSet.labels.size() != profileSet.profiles.size()) {
+    throw EssentiaException("writeProfileSet: there must be one label per profile");
+  }
+
+  ofstream file(filename.c_str(), ios::binary);
+  if (!file) {
+    throw EssentiaException("writeProfileSet: could not open file for writing: ", filename);
+  }
+
+  uint32_t header[2];
+  header[0] = 1;
+  header[1] = (uint32_t)profileSet.numModes();
+  file.write("EDMP", 4);
+  file.write((const char*)header, sizeof(header));
+
+  for (int m=0; m<profileSet.numModes(); m++) {
+    if (profileSet.profiles[m].size() != 12) {
+      throw EssentiaException("writeProfileSet: key profiles must have 12 values");
+    }
+    uint32_t length = (uint32_t)profileSet.labels[m].size();
+    file.write((const char*)&length, sizeof(length));
+    file.write(profileSet.labels[m].data(), length);
+    float values[12];
+    for (int i=0; i<12; i++) values[i] = (float)profileSet.profiles[m][i];
+    file.write((const char*)values, sizeof(values));
+  }
+
+  if (!file) {
+    throw EssentiaException("writeProfileSet: could not write ", filename);
+  }
+}
+
+} // namespace essentia
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_KEYPROFILES_H
+#define ESSENTIA_KEYPROFILES_H
+
+#include "types.h"
+#include <string>
+#include <vector>
+
+namespace essentia {
+
+/**
+  The major, minor and other profiles of KeyEDM3, 12 bins starting on the
+  tonic. Returns false if 'profileType' is not one of bgate, braw or edma.
+*/
+bool edm3Profiles(const std::string& profileType,
+                  std::vector<Real>& major, std::vector<Real>& minor, std::vector<Real>& other);
+
+/**
+  A set of key profiles: one 12-bin profile per mode, starting on the tonic,
+  and the label reported when that mode is estimated.
+*/
+struct KeyProfileSet {
+  std::vector<std::string> labels;
+  std::vector<std::vector<Real> > profiles;
+
+  int numModes() const { return (int)profiles.size(); }
+
+  // index of the mode with this label, -1 if there is none
+  int modeIndex(const std::string& label) const {
+    for (int m=0; m<(int)labels.size(); m++) {
+      if (labels[m] == label) return m;
+    }
+    return -1;
+  }
+};
+
+/**
+  The scale reported when the mode with this label is estimated: the 'other'
+  mode of the EDM sets is reported as minor, and any other label as is.
+*/
+std::string reportedScale(const std::string& label);
+
+/**
+  The profiles of edm3Profiles() as a set labelled major, minor and other.
+  Returns false if 'profileType' is not one of bgate, braw or edma.
+*/
+bool edm3ProfileSet(const std::string& profileType, KeyProfileSet& profileSet);
+
+/**
+  The modal profiles of KeyExtended, labelled ionian, harmonic, mixolydian,
+  phrygian, fifth, monotonic and difficult.
+*/
+void extendedProfileSet(KeyProfileSet& profileSet);
+
+/**
+  Loads a profile set file, so that new profiles can be used without
+  rebuilding Essentia. The profiles are validated (12 finite, non-negative
+  and not flat values, unique non-empty labels) and normalized to a maximum
+  of 1, and throw an EssentiaException if they are not valid.
+
+  Loaded sets are cached by the hash of the file content: loading the same
+  profiles again only costs reading the file, while a file rewritten with
+  new profiles is validated again. The returned reference stays valid until
+  the program ends. Safe to call from several threads.
+
+  File layout, little endian:
+    char[4]  "EDMP"
+    uint32   version (1)
+    uint32   number of modes
+    for every mode:
+      uint32   label length
+      char     label (no terminator)
+      float32  12 profile values, from the tonic
+*/
+const KeyProfileSet& loadProfileSet(const std::string& filename);
+
+/**
+  Writes a profile set in the format read by loadProfileSet().
+*/
+void writeProfileSet(const std::string& filename, const KeyProfileSet& profileSet);
+
+} // namespace essentia
+
+#endif // ESSENTIA_KEYPROFILES_H
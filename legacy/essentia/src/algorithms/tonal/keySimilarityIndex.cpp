@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "keySimilarityIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <queue>
+
+using namespace std;
+
+namespace essentia {
+
+// quantized vectors have a norm of about 127, so the dot product of two of
+// them is about 127*127 times their correlation
+static const Real quantizationScale = 127;
+
+KeySimilarityIndex::KeySimilarityIndex(int dimension) :
+    _dimension(dimension), _offsets(numBuckets+1, 0), _blockOffsets(numBuckets+1, 0) {
+  if (dimension <= 0)
+    throw EssentiaException("KeySimilarityIndex: dimension must be positive");
+}
+
+void KeySimilarityIndex::compatibleKeys(int key, int compatible[4]) {
+  int tonic = key % 12;
+  bool minor = key >= 12;
+  compatible[0] = key;
+  compatible[1] = keyBucket((tonic + 7) % 12, minor);
+  compatible[2] = keyBucket((tonic + 5) % 12, minor);
+  compatible[3] = minor ? keyBucket((tonic + 3) % 12, false) : keyBucket((tonic + 9) % 12, true);
+}
+
+void KeySimilarityIndex::quantize(const Real* features, int8_t* quantized) const {
+  Real mean = 0;
+  for (int i=0; i<_dimension; i++) mean += features[i];
+  mean /= _dimension;
+
+  Real norm = 0;
+  for (int i=0; i<_dimension; i++) norm += (features[i] - mean) * (features[i] - mean);
+  norm = sqrt(norm);
+
+  Real gain = norm > 0 ? quantizationScale / norm : 0;
+  for (int i=0; i<_dimension; i++) {
+    Real v = (features[i] - mean) * gain;
+    quantized[i] = (int8_t)(v < 0 ? v - 0.5 : v + 0.5);
+  }
+}
+
+// first block of every bucket, from the entry offsets
+static void blockOffsets(const vector<uint32_t>& offsets, vector<uint32_t>& blocks) {
+  int numBuckets = KeySimilarityIndex::numBuckets;
+  int blockSize = KeySimilarityIndex::blockSize;
+  blocks.resize(numBuckets+1);
+  blocks[0] = 0;
+  for (int b=0; b<numBuckets; b++) {
+    uint32_t entries = offsets[b+1] - offsets[b];
+    blocks[b+1] = blocks[b] + (entries + blockSize - 1) / blockSize;
+  }
+}
+
+void KeySimilarityIndex::setBlockOffsets() {
+  blockOffsets(_offsets, _blockOffsets);
+}
+
+// bucket of an entry, from the entry offsets
+static int entryBucket(const vector<uint32_t>& offsets, uint32_t entry) {
+  return (int)(upper_bound(offsets.begin(), offsets.end(), entry) - offsets.begin()) - 1;
+}
+
+void KeySimilarityIndex::copyEntry(uint32_t entry, int8_t* features) const {
+  int b = entryBucket(_offsets, entry);
+  uint32_t r = entry - _offsets[b];
+  const int8_t* block = &_blocks[(size_t)(_blockOffsets[b] + r / blockSize) * _dimension * blockSize];
+  for (int i=0; i<_dimension; i++) features[i] = block[i*blockSize + r % blockSize];
+}
+
+void KeySimilarityIndex::add(uint32_t id, int key, const Real* features) {
+  if (key < 0 || key >= numBuckets)
+    throw EssentiaException("KeySimilarityIndex: key out of range");
+
+  _pendingIds.push_back(id);
+  _pendingKeys.push_back((uint8_t)key);
+  _pendingFeatures.resize(_pendingFeatures.size() + _dimension);
+  quantize(features, &_pendingFeatures[_pendingFeatures.size() - _dimension]);
+}
+
+// counting sort of the current and the pending entries by key, then
+// transposition of every bucket into blocks
+void KeySimilarityIndex::build() {
+  if (_pendingIds.empty()) return;
+
+  vector<uint32_t> offsets(numBuckets+1, 0);
+  for (int b=0; b<numBuckets; b++) offsets[b+1] = _offsets[b+1] - _offsets[b];
+  for (int e=0; e<(int)_pendingKeys.size(); e++) offsets[_pendingKeys[e] + 1]++;
+  for (int b=0; b<numBuckets; b++) offsets[b+1] += offsets[b];
+
+  uint32_t total = offsets[numBuckets];
+  vector<uint32_t> ids(total);
+  vector<int8_t> rows((size_t)total * _dimension);
+  vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+
+  for (int b=0; b<numBuckets; b++) {
+    for (uint32_t e=_offsets[b]; e<_offsets[b+1]; e++) {
+      uint32_t to = next[b]++;
+      ids[to] = _ids[e];
+      copyEntry(e, &rows[(size_t)to * _dimension]);
+    }
+  }
+  for (int e=0; e<(int)_pendingIds.size(); e++) {
+    uint32_t to = next[_pendingKeys[e]]++;
+    ids[to] = _pendingIds[e];
+    copy(&_pendingFeatures[(size_t)e * _dimension], &_pendingFeatures[(size_t)e * _dimension] + _dimension,
+         &rows[(size_t)to * _dimension]);
+  }
+
+  _offsets.swap(offsets);
+  _ids.swap(ids);
+  setBlockOffsets();
+
+  _blocks.assign((size_t)_blockOffsets[numBuckets] * _dimension * blockSize, 0);
+  for (int b=0; b<numBuckets; b++) {
+    for (uint32_t e=_offsets[b]; e<_offsets[b+1]; e++) {
+      uint32_t r = e - _offsets[b];
+      int8_t* block = &_blocks[(size_t)(_blockOffsets[b] + r / blockSize) * _dimension * blockSize];
+      const int8_t* row = &rows[(size_t)e * _dimension];
+      for (int i=0; i<_dimension; i++) block[i*blockSize + r % blockSize] = row[i];
+    }
+  }
+
+  _pendingIds.clear();
+  _pendingKeys.clear();
+  _pendingFeatures.clear();
+}
+
+void KeySimilarityIndex::search(const Real* query, int k, vector<KeyNeighbour>& neighbours) const {
+  int buckets[numBuckets];
+  for (int b=0; b<numBuckets; b++) buckets[b] = b;
+  searchBuckets(query, buckets, numBuckets, k, neighbours);
+}
+
+void KeySimilarityIndex::searchCompatible(const Real* query, int key, int k, vector<KeyNeighbour>& neighbours) const {
+  if (key < 0 || key >= numBuckets)
+    throw EssentiaException("KeySimilarityIndex: key out of range");
+
+  int buckets[4];
+  compatibleKeys(key, buckets);
+  searchBuckets(query, buckets, 4, k, neighbours);
+}
+
+// (dot product, entry) pairs; the heap keeps the k best at the top
+typedef pair<int32_t, uint32_t> Candidate;
+
+static bool betterCandidate(const Candidate& a, const Candidate& b) {
+  return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+void KeySimilarityIndex::searchBuckets(const Real* query, const int* buckets, int count, int k,
+                                       vector<KeyNeighbour>& neighbours) const {
+  if (!_pendingIds.empty())
+    throw EssentiaException("KeySimilarityIndex: build() must be called after adding entries");
+
+  neighbours.clear();
+  if (k <= 0) return;
+
+  vector<int8_t> q(_dimension);
+  quantize(query, &q[0]);
+
+  // min-heap on the dot product: its top is the worst of the k best so far
+  priority_queue<Candidate, vector<Candidate>, bool(*)(const Candidate&, const Candidate&)> best(betterCandidate);
+
+  const size_t blockValues = (size_t)_dimension * blockSize;
+
+  for (int c=0; c<count; c++) {
+    int b = buckets[c];
+    uint32_t entries = _offsets[b+1] - _offsets[b];
+
+    for (uint32_t block=0; block<_blockOffsets[b+1]-_blockOffsets[b]; block++) {
+      const int8_t* y = &_blocks[(_blockOffsets[b] + block) * blockValues];
+
+      int32_t dots[blockSize] = { 0 };
+      for (int i=0; i<_dimension; i++, y+=blockSize) {
+        int32_t xi = q[i];
+        for (int r=0; r<blockSize; r++) dots[r] += xi * y[r];
+      }
+
+      int rows = (int)min((uint32_t)blockSize, entries - block*blockSize);
+      for (int r=0; r<rows; r++) {
+        uint32_t e = _offsets[b] + block*blockSize + r;
+        if ((int)best.size() < k) {
+          best.push(Candidate(dots[r], e));
+        }
+        else if (dots[r] > best.top().first) {
+          best.pop();
+          best.push(Candidate(dots[r], e));
+        }
+      }
+    }
+  }
+
+  neighbours.resize(best.size());
+  for (int n=(int)best.size()-1; n>=0; n--) {
+    uint32_t e = best.top().second;
+    neighbours[n].id = _ids[e];
+    neighbours[n].key = entryBucket(_offsets, e);
+    // rounding can take the similarity of identical vectors slightly over 1
+    neighbours[n].similarity = min((Real)1.0, best.top().first / (quantizationScale * quantizationScale));
+    best.pop();
+  }
+}
+
+void KeySimilarityIndex::write(const string& filename) const {
+  if (!_pendingIds.empty())
+    throw EssentiaException("KeySimilarityIndex: build() must be called before writing the index");
+
+  ofstream file(filename.c_str(), ios::binary);
+  if (!file) {
+    throw EssentiaException("KeySimilarityIndex: could not open file for writing: ", filename);
+  }
+
+  uint32_t header[3];
+  header[0] = 1;
+  header[1] = (uint32_t)_dimension;
+  header[2] = (uint32_t)_ids.size();
+
+  file.write("EDMI", 4);
+  file.write((const char*)header, sizeof(header));
+  file.write((const char*)&_offsets[0], _offsets.size() * sizeof(uint32_t));
+  if (!_ids.empty()) {
+    file.write((const char*)&_ids[0], _ids.size() * sizeof(uint32_t));
+    file.write((const char*)&_blocks[0], _blocks.size());
+  }
+}
+
+void KeySimilarityIndex::read(const string& filename) {
+  ifstream file(filename.c_str(), ios::binary);
+  if (!file) {
+    throw EssentiaException("KeySimilarityIndex: could not open file: ", filename);
+  }
+
+  char magic[4];
+  uint32_t header[3];
+  file.read(magic, 4);
+  file.read((char*)header, sizeof(header));
+  if (!file || string(magic, 4) != "EDMI" || header[0] != 1 || header[1] == 0 || header[1] > 0x7fffffff) {
+    throw EssentiaException("KeySimilarityIndex: not a key similarity index: ", filename);
+  }
+
+  // everything is read into locals, so that a failed read leaves the
+  // index as it was
+  uint32_t dimension = header[1];
+  uint32_t count = header[2];
+
+  vector<uint32_t> offsets(numBuckets+1);
+  file.read((char*)&offsets[0], offsets.size() * sizeof(uint32_t));
+  if (!file || offsets[0] != 0 || offsets[numBuckets] != count) {
+    throw EssentiaException("KeySimilarityIndex: corrupt index: ", filename);
+  }
+  for (int b=0; b<numBuckets; b++) {
+    if (offsets[b+1] < offsets[b])
+      throw EssentiaException("KeySimilarityIndex: corrupt index: ", filename);
+  }
+  vector<uint32_t> blocks;
+  blockOffsets(offsets, blocks);
+
+  // check the header against the size of the file before allocating
+  // anything, so that a corrupt index cannot ask for gigabytes. The size of
+  // the blocks is compared by division, as dimension * blocks can overflow
+  streampos position = file.tellg();
+  file.seekg(0, ios::end);
+  uint64_t available = (uint64_t)(file.tellg() - position);
+  file.seekg(position);
+  uint64_t idBytes = (uint64_t)count * sizeof(uint32_t);
+  uint64_t blockBytes = (uint64_t)blocks[numBuckets] * blockSize;  // per dimension
+  bool sizeMatches = available >= idBytes &&
+      (blockBytes == 0 ? available == idBytes :
+       (available - idBytes) % blockBytes == 0 && (available - idBytes) / blockBytes == dimension);
+  if (!sizeMatches) {
+    throw EssentiaException("KeySimilarityIndex: the size of the index does not match its header: ", filename);
+  }
+
+  vector<uint32_t> ids(count);
+  vector<int8_t> values((size_t)blockBytes * dimension);
+  if (count > 0) {
+    file.read((char*)&ids[0], ids.size() * sizeof(uint32_t));
+    file.read((char*)&values[0], values.size());
+  }
+
+  if (!file) {
+    throw EssentiaException("KeySimilarityIndex: truncated index: ", filename);
+  }
+
+  _dimension = (int)dimension;
+  _offsets.swap(offsets);
+  _blockOffsets.swap(blocks);
+  _ids.swap(ids);
+  _blocks.swap(values);
+
+  _pendingIds.clear();
+  _pendingKeys.clear();
+  _pendingFeatures.clear();
+}
+
+} // namespace essentia
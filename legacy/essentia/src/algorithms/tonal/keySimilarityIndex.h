@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_KEYSIMILARITYINDEX_H
+#define ESSENTIA_KEYSIMILARITYINDEX_H
+
+#include "types.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace essentia {
+
+struct KeyNeighbour {
+  uint32_t id;
+  int key;          // keyIndex + 12 for minor keys, see KeySimilarityIndex::keyBucket
+  Real similarity;  // correlation with the query, in [-1, 1]
+};
+
+/**
+  Nearest neighbour index over per-track key descriptions, for harmonic
+  mixing queries.
+
+  Every track is described by a vector of fixed dimension, typically the 36
+  key scores of KeyEstimate (best correlation of the major, minor and other
+  profiles at every tonic) or its 12-bin summed chroma, together with its
+  estimated key. Vectors are centred, normalised and stored with 8 bits per
+  value, so the similarity of two tracks is the correlation of their
+  descriptions, computed as an integer dot product (within about 0.01 of the
+  float value).
+
+  Entries are grouped in 24 buckets by key, so that searchCompatible() only
+  scans the keys next to the query on the Camelot wheel: the same key, a
+  fifth up, a fifth down and its relative major or minor, i.e. 4 buckets out
+  of 24.
+
+  Inside a bucket, entries are stored in blocks of 16, transposed: the i-th
+  values of the 16 entries of a block are contiguous. The scan then
+  accumulates 16 dot products at once, in a loop without branches or
+  reductions that the compiler turns into SIMD multiply-adds for any
+  dimension. The last block of every bucket is padded with zeros.
+
+  The index is filled with add() and made searchable with build(). Searches
+  are const and can run concurrently.
+
+  File layout, little endian:
+    char[4]  "EDMI"
+    uint32   version (1)
+    uint32   dimension
+    uint32   number of entries
+    uint32   25 bucket offsets (entries of bucket b are [offset[b], offset[b+1]) )
+    uint32   id of every entry
+    int8     the blocks of every bucket, dimension*16 values per block
+*/
+class KeySimilarityIndex {
+
+ public:
+  static const int numBuckets = 24;
+  static const int blockSize = 16;
+
+  explicit KeySimilarityIndex(int dimension=36);
+
+  static int keyBucket(int keyIndex, bool minor) { return keyIndex + (minor ? 12 : 0); }
+
+  /**
+    The keys that mix well with 'key' (as returned by keyBucket), following
+    the Camelot wheel: the key itself, a fifth up, a fifth down and the
+    relative major or minor.
+  */
+  static void compatibleKeys(int key, int compatible[4]);
+
+  int dimension() const { return _dimension; }
+  int size() const { return (int)_ids.size(); }
+
+  void add(uint32_t id, int key, const Real* features);
+  void build();
+
+  void search(const Real* query, int k, std::vector<KeyNeighbour>& neighbours) const;
+  void searchCompatible(const Real* query, int key, int k, std::vector<KeyNeighbour>& neighbours) const;
+
+  void write(const std::string& filename) const;
+  void read(const std::string& filename);
+
+ protected:
+  int _dimension;
+
+  std::vector<uint32_t> _offsets;       // first entry of every bucket
+  std::vector<uint32_t> _blockOffsets;  // first block of every bucket
+  std::vector<uint32_t> _ids;
+  std::vector<int8_t> _blocks;
+
+  // entries added since the last call to build()
+  std::vector<uint32_t> _pendingIds;
+  std::vector<uint8_t> _pendingKeys;
+  std::vector<int8_t> _pendingFeatures;
+
+  void quantize(const Real* features, int8_t* quantized) const;
+  void setBlockOffsets();
+  void copyEntry(uint32_t entry, int8_t* features) const;
+  void searchBuckets(const Real* query, const int* buckets, int count, int k, std::vector<KeyNeighbour>& neighbours) const;
+};
+
+} // namespace essentia
+
+#endif // ESSENTIA_KEYSIMILARITYINDEX_H
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "pcpAccumulator.h"
+
+using namespace std;
+
+namespace essentia {
+namespace streaming {
+
+const char* PcpAccumulator::name = "PcpAccumulator";
+const char* PcpAccumulator::category = "Tonal";
+const char* PcpAccumulator::description = DOC("This algorithm sums the pitch class profiles it receives and outputs the total when the end of the stream is reached. It keeps a single running sum instead of storing every frame, so that the accumulated profile of a track can be computed with a memory footprint that does not depend on its duration.\n"
+"\n"
+"With a weighting other than none, every frame is multiplied by its tonal salience before being added: (max - mean) / max for peakiness, and one minus its normalized entropy for entropy. Both are 1 for a single pitch class and 0 for a flat profile, so frames of noise, drums or transitions count less, and the sum is dominated by the most tonal frames.\n"
+"\n"
+"If the stream is empty, the output is an empty vector. PcpAccumulator will throw an exception when the input frames do not all have the same size.");
+
+
+void PcpAccumulator::configure() {
+  _weighting = pcpWeighting(parameter("weighting").toString());
+}
+
+
+void PcpAccumulator::reset() {
+  AccumulatorAlgorithm::reset();
+  _sum.clear();
+}
+
+
+void PcpAccumulator::consume() {
+  const vector<vector<Real> >& frames = _pcp.tokens();
+
+  for (int f=0; f<(int)frames.size(); f++) {
+    accumulatePcp(_sum, frames[f], _weighting);
+  }
+}
+
+
+void PcpAccumulator::finalProduce() {
+  _pcpSum.push(_sum);
+  reset();
+}
+
+} // namespace streaming
+} // namespace essentia
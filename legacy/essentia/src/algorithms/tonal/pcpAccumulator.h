@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_PCPACCUMULATOR_H
+#define ESSENTIA_PCPACCUMULATOR_H
+
+#include "accumulatoralgorithm.h"
+#include "pcpSalience.h"
+
+namespace essentia {
+namespace streaming {
+
+/**
+  Sums the pitch class profiles of a stream of frames and outputs the total
+  once the stream ends. Only the running sum is kept, so the memory used does
+  not depend on the number of frames. Frames can be weighted by their tonal
+  salience (see pcpSalience.h).
+*/
+class PcpAccumulator : public AccumulatorAlgorithm {
+
+ protected:
+  Sink<std::vector<Real> > _pcp;
+  Source<std::vector<Real> > _pcpSum;
+
+  std::vector<Real> _sum;
+  PcpWeighting _weighting;
+
+ public:
+  PcpAccumulator() {
+    declareInputStream(_pcp, "pcp", "the frame-wise pitch class profiles");
+    declareOutputResult(_pcpSum, "pcp", "the sum of all the input pitch class profiles");
+  }
+
+  void declareParameters() {
+    declareParameter("weighting", "the weight of every frame in the sum: none (plain sum) or its tonal salience, from its peakiness or its entropy", "{none,peakiness,entropy}", "none");
+  }
+
+  void configure();
+  void reset();
+  void consume();
+  void finalProduce();
+
+  static const char* name;
+  static const char* category;
+  static const char* description;
+};
+
+} // namespace streaming
+} // namespace essentia
+
+#endif // ESSENTIA_PCPACCUMULATOR_H
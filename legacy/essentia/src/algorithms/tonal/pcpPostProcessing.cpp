@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "pcpPostProcessing.h"
+
+using namespace std;
+
+namespace essentia {
+namespace standard {
+
+const char* PcpPostProcessing::name = "PcpPostProcessing";
+const char* PcpPostProcessing::category = "Tonal";
+const char* PcpPostProcessing::description = DOC("This algorithm prepares a pitch class profile for key estimation. It performs, in a single pass over the input, peak normalization, threshold gating, detuning correction to the nearest tempered bin and a rotation of the reference bin.\n"
+"\n"
+"Detuning correction finds the bin holding the maximum value and rotates the whole profile by the smallest amount that places it on a multiple of pcpSize/12, so it only has an effect for pcp sizes larger than 12. It can be used on the accumulated profile of a track or on every frame.\n"
+"\n"
+"PcpPostProcessing will throw an exception when the input pcp size is not a positive multiple of 12.");
+
+
+void PcpPostProcessing::configure() {
+  _normalize = parameter("normalize").toBool();
+  _threshold = parameter("threshold").toReal();
+  _detuningCorrection = parameter("detuningCorrection").toBool();
+  _referenceShift = parameter("referenceShift").toInt();
+}
+
+
+void PcpPostProcessing::compute() {
+
+  const vector<Real>& pcp = _pcp.get();
+  vector<Real>& pcpOut = _pcpOut.get();
+
+  int pcpsize = (int)pcp.size();
+
+  if (pcpsize < 12 || pcpsize % 12 != 0)
+    throw EssentiaException("PcpPostProcessing: input PCP size is not a positive multiple of 12");
+
+  int n = pcpsize/12;
+
+  // find the peak (first occurrence, as np.where in the python version)
+  int maxIndex = 0;
+  Real maxValue = pcp[0];
+  for (int i=1; i<pcpsize; i++) {
+    if (pcp[i] > maxValue) {
+      maxValue = pcp[i];
+      maxIndex = i;
+    }
+  }
+
+  Real gain = (_normalize && maxValue > 0) ? 1.0 / maxValue : 1.0;
+  Real gate = _threshold * maxValue;
+
+  // total rotation: reference shift plus the distance from the peak to the
+  // nearest tempered bin
+  int shift = _referenceShift * n;
+  if (_detuningCorrection) {
+    int offset = maxIndex % n;
+    shift += (2*offset > n) ? n - offset : -offset;
+  }
+  shift %= pcpsize;
+  if (shift < 0) {
+    shift += pcpsize;
+  }
+
+  pcpOut.resize(pcpsize);
+
+  for (int i=0; i<pcpsize; i++) {
+    int index = i + shift;
+    if (index >= pcpsize) {
+      index -= pcpsize;
+    }
+    pcpOut[index] = (pcp[i] < gate) ? 0.0 : pcp[i] * gain;
+  }
+}
+
+} // namespace standard
+} // namespace essentia
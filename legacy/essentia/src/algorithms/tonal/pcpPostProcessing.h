@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_PCPPOSTPROCESSING_H
+#define ESSENTIA_PCPPOSTPROCESSING_H
+
+#include "algorithm.h"
+
+namespace essentia {
+namespace standard {
+
+class PcpPostProcessing : public Algorithm {
+
+ private:
+  Input<std::vector<Real> > _pcp;
+  Output<std::vector<Real> > _pcpOut;
+
+ public:
+
+  PcpPostProcessing() {
+    declareInput(_pcp, "pcp", "the input pitch class profile");
+    declareOutput(_pcpOut, "pcp", "the normalized, gated and shifted pitch class profile");
+  }
+
+  void declareParameters() {
+    declareParameter("normalize", "scale the pcp so that its maximum value is 1", "{true,false}", true);
+    declareParameter("threshold", "bins below this fraction of the pcp maximum are set to zero (0 disables gating)", "[0,1]", 0.2);
+    declareParameter("detuningCorrection", "shift the pcp so that its maximum falls on the nearest tempered bin", "{true,false}", true);
+    declareParameter("referenceShift", "rotation of the output in semitones (e.g. -3 to make the first bin C instead of A)", "(-inf,inf)", 0);
+    declareParameter("pcpSize", "number of divisions per octave (12*i). This parameter is only a hint; During computation the size of the input PCP is used instead)", "[12,inf)", 36);
+  }
+
+  void compute();
+  void configure();
+
+  static const char* name;
+  static const char* category;
+  static const char* description;
+
+protected:
+  bool _normalize;
+  Real _threshold;
+  bool _detuningCorrection;
+  int _referenceShift;
+};
+
+} // namespace standard
+} // namespace essentia
+
+#include "streamingalgorithmwrapper.h"
+
+namespace essentia {
+namespace streaming {
+
+class PcpPostProcessing : public StreamingAlgorithmWrapper {
+
+ protected:
+  Sink<std::vector<Real> > _pcp;
+  Source<std::vector<Real> > _pcpOut;
+
+ public:
+  PcpPostProcessing() {
+    declareAlgorithm("PcpPostProcessing");
+    declareInput(_pcp, TOKEN, "pcp");
+    declareOutput(_pcpOut, TOKEN, "pcp");
+  }
+};
+
+} // namespace streaming
+} // namespace essentia
+
+#endif // ESSENTIA_PCPPOSTPROCESSING_H
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "pcpQuantization.h"
+#include "essentiamath.h"
+#include <fstream>
+
+using namespace std;
+
+namespace essentia {
+
+static void computeMoments(QuantizedPcp& quantized) {
+  int64_t size = (int64_t)quantized.bins.size();
+  int64_t sumSquares = 0;
+  quantized.sum = 0;
+  for (int i=0; i<(int)size; i++) {
+    int64_t v = quantized.bins[i];
+    quantized.sum += v;
+    sumSquares += v*v;
+  }
+  quantized.variance = size * sumSquares - quantized.sum * quantized.sum;
+}
+
+static uint8_t quantizeValue(Real value, Real gain) {
+  // negative values cannot be represented and are clipped to 0
+  Real v = value * gain + 0.5;
+  return v <= 0 ? 0 : (v >= 255 ? 255 : (uint8_t)v);
+}
+
+void quantizePcp(const vector<Real>& pcp, QuantizedPcp& quantized) {
+  int size = (int)pcp.size();
+
+  Real maxValue = 0;
+  for (int i=0; i<size; i++) {
+    if (pcp[i] > maxValue) maxValue = pcp[i];
+  }
+
+  quantized.bins.resize(size);
+  quantized.scale = maxValue / 255;
+
+  Real gain = maxValue > 0 ? 255 / maxValue : 0;
+  for (int i=0; i<size; i++) {
+    quantized.bins[i] = quantizeValue(pcp[i], gain);
+  }
+
+  computeMoments(quantized);
+}
+
+void dequantizePcp(const QuantizedPcp& quantized, vector<Real>& pcp) {
+  int size = (int)quantized.bins.size();
+  pcp.resize(size);
+  for (int i=0; i<size; i++) {
+    pcp[i] = quantized.bins[i] * quantized.scale;
+  }
+}
+
+Real correlation(const QuantizedPcp& v1, const QuantizedPcp& v2, const int shift) {
+  int size = (int)v1.bins.size();
+  const uint8_t* x = &v1.bins[0];
+  const uint8_t* y = &v2.bins[0];
+
+  // v1[i] is paired with v2[(i - shift) % size]; splitting the loop at the
+  // wrap-around point leaves two contiguous integer dot products
+  int32_t dot = 0;
+  for (int i=shift; i<size; i++) dot += x[i] * y[i - shift];
+  for (int i=0; i<shift; i++) dot += x[i] * y[i - shift + size];
+
+  if (v1.variance == 0 || v2.variance == 0) return 0.0;
+
+  int64_t numerator = size * (int64_t)dot - v1.sum * v2.sum;
+  return (Real)(numerator / sqrt((double)v1.variance * (double)v2.variance));
+}
+
+void quantizeChroma(const vector<vector<Real> >& chroma, QuantizedChroma& quantized) {
+  quantized.frames = (int)chroma.size();
+  quantized.bins = chroma.empty() ? 0 : (int)chroma[0].size();
+
+  Real maxValue = 0;
+  for (int f=0; f<quantized.frames; f++) {
+    if ((int)chroma[f].size() != quantized.bins) {
+      throw EssentiaException("quantizeChroma: all frames must have the same number of bins");
+    }
+    for (int i=0; i<quantized.bins; i++) {
+      if (chroma[f][i] > maxValue) maxValue = chroma[f][i];
+    }
+  }
+
+  quantized.scale = maxValue / 255;
+  quantized.values.resize(quantized.frames * quantized.bins);
+
+  Real gain = maxValue > 0 ? 255 / maxValue : 0;
+  uint8_t* values = quantized.values.empty() ? 0 : &quantized.values[0];
+  for (int f=0; f<quantized.frames; f++) {
+    for (int i=0; i<quantized.bins; i++) {
+      *values++ = quantizeValue(chroma[f][i], gain);
+    }
+  }
+}
+
+void sumQuantizedChroma(const QuantizedChroma& quantized, vector<Real>& pcp) {
+  // integer sums per bin, scaled once at the end
+  vector<int64_t> sums(quantized.bins, 0);
+  for (int f=0; f<quantized.frames && quantized.bins>0; f++) {
+    const uint8_t* frame = &quantized.values[f * quantized.bins];
+    for (int i=0; i<quantized.bins; i++) sums[i] += frame[i];
+  }
+  pcp.resize(quantized.bins);
+  for (int i=0; i<quantized.bins; i++) pcp[i] = sums[i] * quantized.scale;
+}
+
+void writeChromaArchive(const string& filename, const QuantizedChroma& chroma) {
+  ofstream file(filename.c_str(), ios::binary);
+  if (!file) {
+    throw EssentiaException("writeChromaArchive: could not open file for writing: ", filename);
+  }
+
+  uint32_t header[3];
+  header[0] = 2;
+  header[1] = (uint32_t)chroma.frames;
+  header[2] = (uint32_t)chroma.bins;
+  float scale = chroma.scale;
+
+  file.write("EDMC", 4);
+  file.write((const char*)header, sizeof(header));
+  file.write((const char*)&scale, sizeof(float));
+  if (!chroma.values.empty()) {
+    file.write((const char*)&chroma.values[0], chroma.values.size());
+  }
+}
+
+void readChromaArchive(const string& filename, QuantizedChroma& chroma) {
+  ifstream file(filename.c_str(), ios::binary);
+  if (!file) {
+    throw EssentiaException("readChromaArchive: could not open file: ", filename);
+  }
+
+  char magic[4];
+  uint32_t header[3];
+  file.read(magic, 4);
+  file.read((char*)header, sizeof(header));
+  if (!file || string(magic, 4) != "EDMC" || (header[0] != 1 && header[0] != 2)) {
+    throw EssentiaException("readChromaArchive: not a chroma archive: ", filename);
+  }
+
+  uint32_t nFrames = header[1];
+  uint32_t nBins = header[2];
+
+  // check the header against the size of the file before allocating
+  // anything, so that a corrupt archive cannot ask for gigabytes
+  streampos position = file.tellg();
+  file.seekg(0, ios::end);
+  uint64_t available = (uint64_t)(file.tellg() - position);
+  file.seekg(position);
+  uint64_t values = (uint64_t)nFrames * nBins;
+  uint64_t expected = header[0] == 1 ? (uint64_t)nFrames * sizeof(float) + values : sizeof(float) + values;
+  if (expected != available) {
+    throw EssentiaException("readChromaArchive: the size of the chroma archive does not match its header: ", filename);
+  }
+
+  if (header[0] == 1) {
+    // one scale per frame: dequantize, then requantize with a single scale
+    vector<float> scales(nFrames);
+    if (nFrames > 0) file.read((char*)&scales[0], nFrames * sizeof(float));
+    vector<uint8_t> bins(nFrames * nBins);
+    if (!bins.empty()) file.read((char*)&bins[0], bins.size());
+    if (!file) {
+      throw EssentiaException("readChromaArchive: truncated chroma archive: ", filename);
+    }
+    vector<vector<Real> > frames(nFrames, vector<Real>(nBins));
+    for (uint32_t f=0; f<nFrames; f++) {
+      for (uint32_t i=0; i<nBins; i++) frames[f][i] = bins[f*nBins + i] * scales[f];
+    }
+    quantizeChroma(frames, chroma);
+    chroma.bins = (int)nBins;
+    return;
+  }
+
+  float scale;
+  file.read((char*)&scale, sizeof(float));
+  chroma.frames = (int)nFrames;
+  chroma.bins = (int)nBins;
+  chroma.scale = scale;
+  chroma.values.resize(nFrames * nBins);
+  if (!chroma.values.empty()) file.read((char*)&chroma.values[0], chroma.values.size());
+
+  if (!file) {
+    throw EssentiaException("readChromaArchive: truncated chroma archive: ", filename);
+  }
+}
+
+} // namespace essentia
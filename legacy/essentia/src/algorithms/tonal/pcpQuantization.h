@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_PCPQUANTIZATION_H
+#define ESSENTIA_PCPQUANTIZATION_H
+
+#include "types.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace essentia {
+
+/**
+  A pcp stored with 8 bits per bin and one scale per frame, so that
+  value[i] ~= bins[i] * scale. The largest bin is always mapped to 255.
+
+  Compared to float32 storage this takes nbins+4 bytes per frame instead of
+  4*nbins (3x smaller for 12 bins, 3.6x for 36), and 6x/7.2x smaller than
+  float64.
+
+  Accuracy: rounding adds an error of at most d/2 per bin, where d = max/255.
+  For the Pearson correlation r between two quantized vectors x and y of size
+  N, this bounds the error to
+
+    |r_q - r| <= sqrt(N) * (dx/|x - mean(x)| + dy/|y - mean(y)|)
+
+  For the 12-bin bgate profiles (centred norms above 0.8) the profile term is
+  below 0.017. The pcp term grows as the pcp gets flatter: it is 0.027 for a
+  peak-normalized pcp with a centred norm of 0.5. Rounding errors do not add
+  up coherently, so observed errors are much smaller. For random
+  peak-normalized 12-bin pcps matched against bgate, the median error is
+  0.001 and the maximum 0.006. Only near-ties between keys can change.
+
+  'sum' and 'variance' (N * sum of squares - sum^2) cache the integer
+  moments used by the correlation kernel. They are shift invariant, so they
+  are computed once per vector.
+*/
+struct QuantizedPcp {
+  std::vector<uint8_t> bins;
+  Real scale;
+
+  int64_t sum;
+  int64_t variance;
+};
+
+void quantizePcp(const std::vector<Real>& pcp, QuantizedPcp& quantized);
+void dequantizePcp(const QuantizedPcp& quantized, std::vector<Real>& pcp);
+
+/**
+  Pearson correlation of v1 and v2, with v2 circularly shifted by 'shift'
+  (same convention as the float correlation of the Key algorithms). Only the
+  shifted dot product is computed per call, with integer arithmetic.
+*/
+Real correlation(const QuantizedPcp& v1, const QuantizedPcp& v2, const int shift);
+
+/**
+  A chromagram stored with 8 bits per bin and a single scale for the whole
+  track, frame by frame, so that frame f ~= values[f*bins .. (f+1)*bins) *
+  scale. The largest value of the track is mapped to 255.
+
+  This is exactly one byte per bin: 4x smaller than float32 and 8x smaller
+  than float64, whatever the number of bins, with no per-frame overhead.
+  As the frames share the scale, they keep their relative levels and can
+  be summed directly into the track pcp.
+
+  Accuracy: every bin has an error of at most d/2, with d = track max/255.
+  For the sum of F frames that is at most F*d/2 per bin, i.e. c/510 of the
+  peak of the average frame, where c is the ratio between the track max and
+  that peak: below 1% up to c = 5 (14 dB). The correlation bound above then
+  applies to the summed pcp with this error. Single frames much quieter than
+  the loudest one are quantized coarsely, relative to their own peak, and
+  should not be correlated on their own.
+*/
+struct QuantizedChroma {
+  int frames;
+  int bins;
+  Real scale;
+  std::vector<uint8_t> values;
+};
+
+void quantizeChroma(const std::vector<std::vector<Real> >& chroma, QuantizedChroma& quantized);
+
+/**
+  Sum of the frames of a quantized chromagram, as floats.
+*/
+void sumQuantizedChroma(const QuantizedChroma& quantized, std::vector<Real>& pcp);
+
+/**
+  Chroma archive, one file per track, little endian:
+    char[4]  "EDMC"
+    uint32   version (2)
+    uint32   number of frames
+    uint32   number of bins per frame
+    float32  scale of the track
+    uint8    bins, frame by frame
+  The python scripts write the same layout (see write_chroma_archive).
+  Version 1 archives (a float32 scale per frame before the bins) are still
+  read, and requantized with a single scale. readChromaArchive throws an
+  EssentiaException if the size of the file does not match its header.
+*/
+void writeChromaArchive(const std::string& filename, const QuantizedChroma& chroma);
+void readChromaArchive(const std::string& filename, QuantizedChroma& chroma);
+
+} // namespace essentia
+
+#endif // ESSENTIA_PCPQUANTIZATION_H
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "pcpSalience.h"
+#include "essentiamath.h"
+
+using namespace std;
+
+namespace essentia {
+
+PcpWeighting pcpWeighting(const string& name) {
+  if (name == "none") return PCP_UNIFORM;
+  if (name == "peakiness") return PCP_PEAKINESS;
+  if (name == "entropy") return PCP_ENTROPY;
+  throw EssentiaException("pcpWeighting: unknown frame weighting: ", name);
+}
+
+
+Real pcpSalience(const vector<Real>& pcp, PcpWeighting weighting) {
+  if (weighting == PCP_UNIFORM) return 1.0;
+
+  int size = (int)pcp.size();
+  Real sum = 0.0;
+  Real maximum = 0.0;
+  for (int i=0; i<size; i++) {
+    sum += pcp[i];
+    if (pcp[i] > maximum) maximum = pcp[i];
+  }
+  if (size < 2 || sum <= 0) return 0.0;
+
+  if (weighting == PCP_PEAKINESS) {
+    return (maximum - sum / size) / maximum;
+  }
+
+  Real entropy = 0.0;
+  for (int i=0; i<size; i++) {
+    if (pcp[i] <= 0) continue;
+    Real p = pcp[i] / sum;
+    entropy -= p * log(p);
+  }
+  return 1.0 - entropy / log((Real)size);
+}
+
+
+void accumulatePcp(vector<Real>& sum, const vector<Real>& pcp, PcpWeighting weighting) {
+  if (sum.empty()) {
+    sum.resize(pcp.size(), (Real)0.0);
+  }
+  else if (pcp.size() != sum.size()) {
+    throw EssentiaException("accumulatePcp: all the input pcps must have the same size");
+  }
+
+  Real weight = pcpSalience(pcp, weighting);
+  for (int i=0; i<(int)pcp.size(); i++) {
+    sum[i] += weight * pcp[i];
+  }
+}
+
+} // namespace essentia
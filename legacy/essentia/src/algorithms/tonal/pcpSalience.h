@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_PCPSALIENCE_H
+#define ESSENTIA_PCPSALIENCE_H
+
+#include "types.h"
+#include <string>
+#include <vector>
+
+namespace essentia {
+
+/**
+  Tonal salience of a single pcp frame, used to weight frames when they are
+  accumulated into the pcp of a track. Frames with a few strong pitch classes
+  (chords, bass lines) get weights close to 1, and flat frames (noise, drums,
+  transitions) weights close to 0, so the accumulated pcp is dominated by the
+  tonal frames and becomes stable after fewer frames.
+
+  PCP_UNIFORM    every frame weighs 1, as a plain sum
+  PCP_PEAKINESS  (max - mean) / max
+  PCP_ENTROPY    1 - H(p) / log(size), with p the pcp normalized to sum 1
+
+  Empty and all-zero frames weigh 0 with the last two.
+*/
+enum PcpWeighting {
+  PCP_UNIFORM,
+  PCP_PEAKINESS,
+  PCP_ENTROPY
+};
+
+/**
+  Parses a weighting name ("none", "peakiness" or "entropy"), throwing an
+  EssentiaException for any other name.
+*/
+PcpWeighting pcpWeighting(const std::string& name);
+
+Real pcpSalience(const std::vector<Real>& pcp, PcpWeighting weighting);
+
+/**
+  Adds a pcp frame, multiplied by its salience, to a running sum, which is
+  sized on the first frame. Throws an EssentiaException when the frame and
+  the sum have different sizes. PcpAccumulator and the streaming KeyEDM3
+  accumulate their frames with it.
+*/
+void accumulatePcp(std::vector<Real>& sum, const std::vector<Real>& pcp, PcpWeighting weighting);
+
+} // namespace essentia
+
+#endif // ESSENTIA_PCPSALIENCE_H
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "pcpTuning.h"
+#include "essentiamath.h"
+
+using namespace std;
+
+namespace essentia {
+
+Real estimatePcpTuning(const vector<Real>& pcp) {
+  int pcpsize = (int)pcp.size();
+  int n = pcpsize/12;
+
+  if (n <= 1) return 0.0;
+
+  Real re = 0.0;
+  Real im = 0.0;
+  for (int i=0; i<pcpsize; i++) {
+    Real phase = 2*M_PI * (i % n) / n;
+    re += pcp[i] * cos(phase);
+    im += pcp[i] * sin(phase);
+  }
+
+  if (re == 0 && im == 0) return 0.0;
+
+  // atan2 returns (-pi, pi], which maps to (-n/2, n/2] bins
+  return atan2(im, re) * n / (2*M_PI);
+}
+
+void foldPcp(const vector<Real>& pcp, Real offset, vector<Real>& folded) {
+  int pcpsize = (int)pcp.size();
+  int n = pcpsize/12;
+
+  folded.assign(12, (Real)0.0);
+
+  for (int i=0; i<pcpsize; i++) {
+    // position of bin i in semitones, relative to the tuned grid
+    Real position = (i - offset) / n;
+    Real before = floor(position);
+    Real fraction = position - before;
+
+    int ibefore = (int)before % 12;
+    if (ibefore < 0) ibefore += 12;
+    int iafter = (ibefore + 1) % 12;
+
+    folded[ibefore] += (1 - fraction) * pcp[i];
+    folded[iafter]  += fraction * pcp[i];
+  }
+}
+
+} // namespace essentia
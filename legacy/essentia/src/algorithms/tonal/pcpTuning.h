@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_PCPTUNING_H
+#define ESSENTIA_PCPTUNING_H
+
+#include "types.h"
+#include <vector>
+
+namespace essentia {
+
+/**
+  Estimates the global deviation from equal temperament of a pcp with
+  n = pcp.size()/12 bins per semitone. Every bin votes with its energy for its
+  position inside the semitone, and the votes are averaged on the circle.
+  Returns the offset in bins, in the range (-n/2, n/2]. It is always 0 for
+  12-bin profiles.
+*/
+Real estimatePcpTuning(const std::vector<Real>& pcp);
+
+/**
+  Folds a high resolution pcp into 12 bins centred on the tempered positions
+  shifted by 'offset' bins. Each input bin is shared between the two nearest
+  semitone centres by linear interpolation, so the total energy is preserved.
+*/
+void foldPcp(const std::vector<Real>& pcp, Real offset, std::vector<Real>& folded);
+
+} // namespace essentia
+
+#endif // ESSENTIA_PCPTUNING_H
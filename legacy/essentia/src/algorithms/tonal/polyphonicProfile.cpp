@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "polyphonicProfile.h"
+#include "essentiamath.h"
+
+using namespace std;
+
+namespace essentia {
+
+PolyphonicProfile::PolyphonicProfile() : _numHarmonics(-1), _slope(-1) {
+  clear();
+}
+
+/**
+  Each note contribute to the different harmonics:
+  1.- first  harmonic  f   -> i
+  2.- second harmonic  2*f -> i
+  3.- third  harmonic  3*f -> i+7
+  4.- fourth harmonic  4*f -> i
+  ..
+  The contribution is weighted depending of the slope. Row 'pitchclass' of
+  the spread matrix holds the contribution of a note of unit weight.
+*/
+void PolyphonicProfile::configure(int numHarmonics, Real slope) {
+  if (numHarmonics == _numHarmonics && slope == _slope) return;
+
+  _numHarmonics = numHarmonics;
+  _slope = slope;
+
+  for (int pitchclass=0; pitchclass<12; pitchclass++) {
+    Real* row = _spread[pitchclass];
+    for (int i=0; i<12; i++) row[i] = 0.0;
+
+    Real weight = 1.0;
+
+    for (int iHarm = 1; iHarm <= _numHarmonics; iHarm++) {
+
+      Real index  = pitchclass + 12*log2((Real)iHarm);
+
+      Real before = floor(index);
+      Real after  = ceil (index);
+
+      int ibefore= (int) fmod((Real)before,(Real)12.0);
+      int iafter = (int) fmod((Real)after ,(Real)12.0);
+
+      // weight goes proportionally to ibefore & iafter
+      if (ibefore < iafter) {
+        Real distance_before = index-before;
+        row[ibefore] += pow(cos(0.5*M_PI*distance_before),2)*weight;
+
+        Real distance_after  = after-index;
+        row[iafter ] += pow(cos(0.5*M_PI*distance_after ),2)*weight;
+      }
+      else { // equal
+        row[ibefore] += weight;
+      }
+      weight *= _slope;
+    }
+  }
+}
+
+void PolyphonicProfile::clear() {
+  for (int i=0; i<12; i++) _notes[i] = 0.0;
+}
+
+void PolyphonicProfile::addNote(const int pitchclass, const Real contribution) {
+  _notes[pitchclass % 12] += contribution;
+}
+
+/**
+  Adds the contribution of a chord built from 'root' and the given intervals
+  (in semitones above the root). All the notes of the chord have the same
+  weight.
+*/
+void PolyphonicProfile::addChord(const int root, const vector<int>& intervals, const Real contribution) {
+  addNote(root, contribution);
+  for (int i=0; i<(int)intervals.size(); i++) {
+    addNote(root + intervals[i], contribution);
+  }
+}
+
+/**
+  A major triad includes notes from three different classes of pitch: the root, the major 3rd and perfect 5th.
+  This is the most relaxed, most consonant chord in all of harmony.
+  @see http://www.songtrellis.com/directory/1146/chordTypes/majorChordTypes/majorTriad
+*/
+void PolyphonicProfile::addMajorTriad(const int root, const Real contribution) {
+  addNote(root, contribution);
+  addNote(root + 4, contribution);
+  addNote(root + 7, contribution);
+}
+
+/**
+  A minor triad includes notes from three different classes of pitch: the root, the minor 3rd and perfect 5th.
+  @see http://www.songtrellis.com/directory/1146/chordTypes/minorChordTypes/minorTriadMi
+*/
+void PolyphonicProfile::addMinorTriad(const int root, const Real contribution) {
+  addNote(root, contribution);
+  addNote(root + 3, contribution);
+  addNote(root + 7, contribution);
+}
+
+// profile[j] = sum_i notes[i] * spread[i][j]
+vector<Real> PolyphonicProfile::profile() const {
+  vector<Real> result(12, (Real)0.0);
+  for (int i=0; i<12; i++) {
+    if (_notes[i] == 0) continue;
+    for (int j=0; j<12; j++) {
+      result[j] += _notes[i] * _spread[i][j];
+    }
+  }
+  return result;
+}
+
+} // namespace essentia
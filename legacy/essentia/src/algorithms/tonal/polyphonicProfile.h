@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_POLYPHONICPROFILE_H
+#define ESSENTIA_POLYPHONICPROFILE_H
+
+#include "types.h"
+#include <vector>
+
+namespace essentia {
+
+/**
+  Builds a 12-bin pitch class profile from a set of chords.
+
+  Chords are added as weighted notes. The profile is obtained by multiplying
+  the accumulated note weights by a 12x12 harmonic spread matrix, where row i
+  holds the contribution of a note with pitch class i to every pitch class
+  once its harmonics are taken into account. The matrix only depends on the
+  number of harmonics and the slope, so it is computed once and kept across
+  calls to configure() with the same values.
+*/
+class PolyphonicProfile {
+
+ public:
+  PolyphonicProfile();
+
+  void configure(int numHarmonics, Real slope);
+  void clear();
+
+  void addNote(const int pitchclass, const Real contribution);
+  void addChord(const int root, const std::vector<int>& intervals, const Real contribution);
+  void addMajorTriad(const int root, const Real contribution);
+  void addMinorTriad(const int root, const Real contribution);
+
+  std::vector<Real> profile() const;
+
+ protected:
+  int _numHarmonics;
+  Real _slope;
+
+  Real _spread[12][12];
+  Real _notes[12];
+};
+
+} // namespace essentia
+
+#endif // ESSENTIA_POLYPHONICPROFILE_H
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#include "spectrumHPCP.h"
+#include "essentiamath.h"
+
+using namespace std;
+
+namespace essentia {
+namespace standard {
+
+const char* SpectrumHPCP::name = "SpectrumHPCP";
+const char* SpectrumHPCP::category = "Tonal";
+// width of the bands of the whitening envelope, as in SpectralWhitening
+static const Real whiteningBandWidth = 100.0;
+
+const char* SpectrumHPCP::description = DOC("This algorithm computes a harmonic pitch class profile directly from a magnitude spectrum, without peak detection. It is a faster replacement, for key estimation, of the SpectralPeaks and HPCP chain.\n"
+"\n"
+"When whitening is enabled, the magnitudes are first divided by the spectral envelope of the frame, as SpectralWhitening does with the peaks: the envelope is the maximum magnitude, in dB, of every band of 100 Hz up to maxFrequency, linearly interpolated between band centres.\n"
+"\n"
+"Every spectrum bin between minFrequency and maxFrequency is treated as a peak at the centre frequency of the bin, and it contributes to the pitch classes of the fundamentals it may be a harmonic of, with the harmonic weights, the weighting window and the squared (whitened) magnitudes used by HPCP. These contributions only depend on the parameters and on the spectrum size, so they are precomputed once as a sparse matrix, and each frame costs a single sparse matrix-vector product.\n"
+"\n"
+"The output differs from HPCP in two ways. All the bins contribute, including window sidelobes and bins below the magnitude threshold of SpectralPeaks. Frequencies are not refined by peak interpolation, so below a few hundred Hz, where a spectrum bin spans more than a semitone, the energy is spread over several pitch classes. With a high-pass filter at 200 Hz, as in the key extractors, key estimates are rarely affected. Use the -b -c options of edmkey_essentia_legacy.py (compare_chroma_kernels) to measure the differences on a collection, with MIREX scores against its annotations.\n"
+"\n"
+"SpectrumHPCP will throw an exception when the spectrum is empty.");
+
+
+void SpectrumHPCP::configure() {
+  _size = parameter("size").toInt();
+  _referenceFrequency = parameter("referenceFrequency").toReal();
+  _harmonics = parameter("harmonics").toInt();
+  _minFrequency = parameter("minFrequency").toReal();
+  _maxFrequency = parameter("maxFrequency").toReal();
+  _weightType = parameter("weightType").toString();
+  _windowSize = parameter("windowSize").toReal();
+  _normalized = parameter("normalized").toString();
+  _sampleRate = parameter("sampleRate").toReal();
+  _whitening = parameter("whitening").toBool();
+
+  if (_size % 12 != 0) {
+    throw EssentiaException("SpectrumHPCP: The size parameter is not a multiple of 12.");
+  }
+  if (_maxFrequency <= _minFrequency) {
+    throw EssentiaException("SpectrumHPCP: maxFrequency must be higher than minFrequency");
+  }
+
+  // the weights are built for the size of the first spectrum
+  _spectrumSize = 0;
+  _rowStart.clear();
+  _columns.clear();
+  _weights.clear();
+}
+
+
+void SpectrumHPCP::buildWeights(int spectrumSize) {
+  _spectrumSize = spectrumSize;
+
+  // Harmonic contributions, as in HPCP: the i-th harmonic is 12*log2(i)
+  // semitones above its fundamental, weighted by the inverse of its octave
+  vector<Real> harmonicSemitones;
+  vector<Real> harmonicStrengths;
+  for (int i=0; i<=_harmonics; i++) {
+    Real semitone = 12.0 * log2(i + 1.0);
+    Real octweight = max((Real)1.0, (Real)(semitone / 12.0) * (Real)0.5);
+    while (semitone >= 12.0 - 1e-5) semitone -= 12.0;
+
+    int h = 0;
+    while (h < (int)harmonicSemitones.size() && fabs(harmonicSemitones[h] - semitone) > 1e-5) h++;
+    if (h == (int)harmonicSemitones.size()) {
+      harmonicSemitones.push_back(semitone);
+      harmonicStrengths.push_back(1.0 / octweight);
+    }
+    else {
+      harmonicStrengths[h] += 1.0 / octweight;
+    }
+  }
+
+  Real resolution = _size / 12;  // bins per semitone
+  Real binWidth = _sampleRate / (2.0 * (spectrumSize - 1));
+
+  _rowStart.assign(spectrumSize + 1, 0);
+  _columns.clear();
+  _weights.clear();
+
+  vector<Real> row(_size);
+
+  for (int k=0; k<spectrumSize; k++) {
+    _rowStart[k] = (int)_columns.size();
+
+    Real freq = k * binWidth;
+    if (freq < _minFrequency || freq > _maxFrequency) continue;
+
+    fill(row.begin(), row.end(), (Real)0.0);
+
+    for (int h=0; h<(int)harmonicSemitones.size(); h++) {
+      Real fundamental = freq * pow((Real)2.0, -harmonicSemitones[h] / (Real)12.0);
+      Real harmonicWeight = harmonicStrengths[h] * harmonicStrengths[h];
+
+      // position of the fundamental in hpcp bins, and the bins of its window
+      Real pcpBinF = log2(fundamental / _referenceFrequency) * (Real)_size;
+      int leftBin = (int)ceil(pcpBinF - resolution * _windowSize / 2.0);
+      int rightBin = (int)floor(pcpBinF + resolution * _windowSize / 2.0);
+
+      for (int i=leftBin; i<=rightBin; i++) {
+        Real distance = fabs(pcpBinF - (Real)i) / resolution;
+        Real w = 1.0;
+        if (_weightType == "cosine") {
+          w = cos(M_PI * distance / _windowSize);
+        }
+        else if (_weightType == "squaredCosine") {
+          w = cos(M_PI * distance / _windowSize);
+          w *= w;
+        }
+        int iCircular = (i % _size + _size) % _size;
+        row[iCircular] += w * harmonicWeight;
+      }
+    }
+
+    for (int i=0; i<_size; i++) {
+      if (row[i] != 0) {
+        _columns.push_back(i);
+        _weights.push_back(row[i]);
+      }
+    }
+  }
+  _rowStart[spectrumSize] = (int)_columns.size();
+
+  // interpolation of the whitening envelope at every bin up to maxFrequency
+  _nBands = (int)ceil(_maxFrequency / whiteningBandWidth);
+  _bandMax.assign(_nBands, (Real)0.0);
+  _envelope.assign(_nBands, (Real)0.0);
+  _envelopeBand.assign(spectrumSize, 0);
+  _envelopeFraction.assign(spectrumSize, (Real)0.0);
+  for (int k=0; k<spectrumSize; k++) {
+    Real position = k * binWidth / whiteningBandWidth - 0.5;  // in bands, from the first centre
+    if (position <= 0) continue;
+    if (position >= _nBands - 1) {
+      _envelopeBand[k] = _nBands - 1;
+      continue;
+    }
+    _envelopeBand[k] = (int)position;
+    _envelopeFraction[k] = position - _envelopeBand[k];
+  }
+}
+
+
+void SpectrumHPCP::estimateEnvelope(const vector<Real>& spectrum) {
+  int spectrumSize = (int)spectrum.size();
+  Real binWidth = _sampleRate / (2.0 * (spectrumSize - 1));
+
+  fill(_bandMax.begin(), _bandMax.end(), (Real)0.0);
+  for (int k=0; k<spectrumSize; k++) {
+    Real freq = k * binWidth;
+    if (freq > _maxFrequency) break;
+    int band = min((int)(freq / whiteningBandWidth), _nBands - 1);
+    if (spectrum[k] > _bandMax[band]) _bandMax[band] = spectrum[k];
+  }
+  for (int b=0; b<_nBands; b++) {
+    _envelope[b] = amp2db(_bandMax[b]);
+  }
+}
+
+
+void SpectrumHPCP::compute() {
+  const vector<Real>& spectrum = _spectrum.get();
+  vector<Real>& hpcp = _hpcp.get();
+
+  int spectrumSize = (int)spectrum.size();
+  if (spectrumSize < 2) {
+    throw EssentiaException("SpectrumHPCP: the input spectrum is empty");
+  }
+
+  if (spectrumSize != _spectrumSize) {
+    buildWeights(spectrumSize);
+  }
+
+  hpcp.assign(_size, (Real)0.0);
+
+  if (_whitening) {
+    estimateEnvelope(spectrum);
+  }
+
+  for (int k=0; k<spectrumSize; k++) {
+    int end = _rowStart[k+1];
+    if (_rowStart[k] == end || spectrum[k] == 0) continue;
+
+    Real magnitude = spectrum[k];
+    if (_whitening) {
+      int band = _envelopeBand[k];
+      Real fraction = _envelopeFraction[k];
+      Real envelope = fraction > 0 ? (1.0 - fraction) * _envelope[band] + fraction * _envelope[band + 1]
+                                   : _envelope[band];
+      magnitude *= db2amp(-envelope);
+    }
+
+    // contributions are proportional to the squared magnitude, as in HPCP
+    Real energy = magnitude * magnitude;
+    for (int e=_rowStart[k]; e<end; e++) {
+      hpcp[_columns[e]] += _weights[e] * energy;
+    }
+  }
+
+  if (_normalized == "unitMax") {
+    normalize(hpcp);
+  }
+  else if (_normalized == "unitSum") {
+    normalizeSum(hpcp);
+  }
+}
+
+} // namespace standard
+} // namespace essentia
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef ESSENTIA_SPECTRUMHPCP_H
+#define ESSENTIA_SPECTRUMHPCP_H
+
+#include "algorithm.h"
+
+namespace essentia {
+namespace standard {
+
+class SpectrumHPCP : public Algorithm {
+
+ private:
+  Input<std::vector<Real> > _spectrum;
+  Output<std::vector<Real> > _hpcp;
+
+ public:
+
+  SpectrumHPCP() {
+    declareInput(_spectrum, "spectrum", "the input magnitude spectrum");
+    declareOutput(_hpcp, "hpcp", "the resulting harmonic pitch class profile");
+  }
+
+  void declareParameters() {
+    declareParameter("size", "the size of the output HPCP (must be a positive nonzero multiple of 12)", "[12,inf)", 12);
+    declareParameter("referenceFrequency", "the reference frequency for semitone index calculation, corresponding to A3 [Hz]", "(0,inf)", 440.0);
+    declareParameter("harmonics", "number of harmonics for frequency contribution, 0 indicates exclusive fundamental frequency contribution", "[0,inf)", 4);
+    declareParameter("minFrequency", "the minimum frequency that contributes to the HPCP [Hz]", "(0,inf)", 25.0);
+    declareParameter("maxFrequency", "the maximum frequency that contributes to the HPCP [Hz]", "(0,inf)", 3500.0);
+    declareParameter("weightType", "type of weighting function for determining frequency contribution", "{none,cosine,squaredCosine}", "cosine");
+    declareParameter("windowSize", "the size, in semitones, of the window used for the weighting", "(0,12]", 1.0);
+    declareParameter("normalized", "whether to normalize the HPCP vector", "{none,unitSum,unitMax}", "unitMax");
+    declareParameter("sampleRate", "the sampling rate of the audio signal [Hz]", "(0,inf)", 44100.);
+    declareParameter("whitening", "whether to whiten the spectrum by its envelope before the mapping, as SpectralWhitening does with the peaks", "{true,false}", true);
+  }
+
+  void compute();
+  void configure();
+
+  static const char* name;
+  static const char* category;
+  static const char* description;
+
+protected:
+  int _size;
+  Real _referenceFrequency;
+  int _harmonics;
+  Real _minFrequency;
+  Real _maxFrequency;
+  std::string _weightType;
+  Real _windowSize;
+  std::string _normalized;
+  Real _sampleRate;
+  bool _whitening;
+
+  // sparse spectrum bin to hpcp bin weights, one row per spectrum bin:
+  // row k holds the entries [_rowStart[k], _rowStart[k+1])
+  int _spectrumSize;
+  std::vector<int> _rowStart;
+  std::vector<int> _columns;
+  std::vector<Real> _weights;
+
+  // whitening envelope: band maxima in dB, and the band and interpolation
+  // fraction of every spectrum bin between band centres
+  int _nBands;
+  std::vector<int> _envelopeBand;
+  std::vector<Real> _envelopeFraction;
+  std::vector<Real> _bandMax;
+  std::vector<Real> _envelope;
+
+  void buildWeights(int spectrumSize);
+  void estimateEnvelope(const std::vector<Real>& spectrum);
+};
+
+} // namespace standard
+} // namespace essentia
+
+#include "streamingalgorithmwrapper.h"
+
+namespace essentia {
+namespace streaming {
+
+class SpectrumHPCP : public StreamingAlgorithmWrapper {
+
+ protected:
+  Sink<std::vector<Real> > _spectrum;
+  Source<std::vector<Real> > _hpcp;
+
+ public:
+  SpectrumHPCP() {
+    declareAlgorithm("SpectrumHPCP");
+    declareInput(_spectrum, TOKEN, "spectrum");
+    declareOutput(_hpcp, TOKEN, "hpcp");
+  }
+};
+
+} // namespace streaming
+} // namespace essentia
+
+#endif // ESSENTIA_SPECTRUMHPCP_H
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+// Learns key profiles from annotated chroma and writes them as a profile file
+// that KeyEDM3 can load with its 'profileFile' parameter.
+//
+// Every track is read from a chroma archive (<name>.chroma, as written by
+// edmkey.py) and its annotation from <name>.txt or <name>.key, in the format
+// read by evaluation.py ("C minor", "F#\tmajor", ...). The frames of a track
+// are summed, corrected for detuning and folded to 12 bins, normalized to a
+// maximum of 1 and gated (bins below the gate are set to 0, as PCP_THRESHOLD
+// does in the key extractors), then rotated so that the annotated tonic is
+// the first bin. The profile of a mode is the mean of its tracks,
+// normalized to a maximum of 1.
+//
+// Tracks are split between threads, each of which accumulates its own
+// per-mode sums, and the partial sums are added at the end, so no locking is
+// needed while reading the archives.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include <dirent.h>
+#include <pthread.h>
+#include "keyProfiles.h"
+#include "pcpQuantization.h"
+#include "pcpTuning.h"
+
+using namespace std;
+using namespace essentia;
+
+// per-mode sums of tonic-rotated profiles
+struct ModeSums {
+  map<string, vector<double> > sums;
+  map<string, int> counts;
+};
+
+struct TrainingJob {
+  const vector<string>* names;
+  string chromaDir;
+  string annotationDir;
+  Real gate;
+  int first;
+  int step;
+
+  ModeSums result;
+  int skipped;
+};
+
+
+// pitch class of a note name, with C = 0, or -1 for unknown tonics
+int noteToPitchClass(const string& note) {
+  const char* names[] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+  const char* flats[] = { "B#", "Db", "D", "Eb", "Fb", "E#", "Gb", "G", "Ab", "A", "Bb", "Cb" };
+  for (int i=0; i<12; i++) {
+    if (note == names[i] || note == flats[i]) return i;
+  }
+  return -1;
+}
+
+// same mode names as mode_to_num() in evaluation.py: maj, M or none are major
+string normalizeMode(const string& mode) {
+  if (mode.empty() || mode == "maj" || mode == "M") return "major";
+  if (mode == "min" || mode == "m") return "minor";
+  return mode;
+}
+
+bool readAnnotation(const string& annotationDir, const string& name, int& tonic, string& mode) {
+  ifstream file((annotationDir + "/" + name + ".txt").c_str());
+  if (!file) file.open((annotationDir + "/" + name + ".key").c_str());
+  if (!file) return false;
+
+  string line;
+  getline(file, line);
+  istringstream fields(line);
+  string note;
+  fields >> note >> mode;
+
+  tonic = noteToPitchClass(note);
+  mode = normalizeMode(mode);
+  return tonic >= 0;
+}
+
+void* train(void* arg) {
+  TrainingJob& job = *(TrainingJob*)arg;
+  const vector<string>& names = *job.names;
+
+  QuantizedChroma chroma;
+  vector<Real> pcp;
+  vector<Real> folded;
+
+  for (int t=job.first; t<(int)names.size(); t+=job.step) {
+    int tonic;
+    string mode;
+    if (!readAnnotation(job.annotationDir, names[t], tonic, mode)) {
+      job.skipped++;
+      continue;
+    }
+
+    // an exception must not escape the thread: a track that cannot be read
+    // or processed, for whatever reason, is skipped
+    try {
+      readChromaArchive(job.chromaDir + "/" + names[t] + ".chroma", chroma);
+      if (chroma.frames == 0 || chroma.bins < 12 || chroma.bins % 12 != 0) {
+        job.skipped++;
+        continue;
+      }
+
+      sumQuantizedChroma(chroma, pcp);
+
+      foldPcp(pcp, estimatePcpTuning(pcp), folded);
+
+      Real maximum = 0;
+      for (int i=0; i<12; i++) maximum = max(maximum, folded[i]);
+      if (maximum <= 0) {
+        job.skipped++;
+        continue;
+      }
+
+      // the first bin of the chroma is A
+      int tonicBin = (tonic + 3) % 12;
+
+      vector<double>& sums = job.result.sums[mode];
+      sums.resize(12, 0.0);
+      for (int i=0; i<12; i++) {
+        Real value = folded[(tonicBin + i) % 12] / maximum;
+        if (value >= job.gate) sums[i] += value;
+      }
+      job.result.counts[mode]++;
+    }
+    catch (exception&) {
+      job.skipped++;
+    }
+  }
+  return 0;
+}
+
+vector<string> listChromaArchives(const string& chromaDir) {
+  vector<string> names;
+  DIR* dir = opendir(chromaDir.c_str());
+  if (!dir) return names;
+
+  const string extension = ".chroma";
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != 0) {
+    string file = entry->d_name;
+    if (file.size() > extension.size() &&
+        file.compare(file.size() - extension.size(), extension.size(), extension) == 0) {
+      names.push_back(file.substr(0, file.size() - extension.size()));
+    }
+  }
+  closedir(dir);
+  return names;
+}
+
+int main(int argc, char* argv[]) {
+
+  if (argc < 4 || argc > 6) {
+    cout << "Error: incorrect number of arguments." << endl;
+    cout << "Usage: " << argv[0] << " chroma_dir annotations_dir profile_output [threads [gate]]" << endl;
+    cout << "  threads: number of threads (default 4)" << endl;
+    cout << "  gate:    bins of the normalized track profiles below it are ignored (default 0.2)" << endl;
+    exit(1);
+  }
+
+  string chromaDir = argv[1];
+  string annotationDir = argv[2];
+  string outputFilename = argv[3];
+  int nThreads = argc > 4 ? atoi(argv[4]) : 4;
+  Real gate = argc > 5 ? atof(argv[5]) : 0.2;
+
+  if (nThreads < 1) {
+    cout << "Error: the number of threads must be positive" << endl;
+    exit(1);
+  }
+
+  vector<string> names = listChromaArchives(chromaDir);
+  if (names.empty()) {
+    cout << "Error: no chroma archives found in " << chromaDir << endl;
+    exit(1);
+  }
+
+  vector<TrainingJob> jobs(nThreads);
+  vector<pthread_t> threads(nThreads);
+  for (int t=0; t<nThreads; t++) {
+    jobs[t].names = &names;
+    jobs[t].chromaDir = chromaDir;
+    jobs[t].annotationDir = annotationDir;
+    jobs[t].gate = gate;
+    jobs[t].first = t;
+    jobs[t].step = nThreads;
+    jobs[t].skipped = 0;
+    pthread_create(&threads[t], 0, train, &jobs[t]);
+  }
+
+  // reduction of the per-thread sums
+  ModeSums total;
+  int skipped = 0;
+  for (int t=0; t<nThreads; t++) {
+    pthread_join(threads[t], 0);
+    const ModeSums& partial = jobs[t].result;
+    for (map<string, vector<double> >::const_iterator it=partial.sums.begin(); it!=partial.sums.end(); ++it) {
+      vector<double>& sums = total.sums[it->first];
+      sums.resize(12, 0.0);
+      for (int i=0; i<12; i++) sums[i] += it->second[i];
+      total.counts[it->first] += partial.counts.find(it->first)->second;
+    }
+    skipped += jobs[t].skipped;
+  }
+
+  // major and minor first, then the other modes in alphabetical order
+  vector<string> modes;
+  if (total.sums.count("major")) modes.push_back("major");
+  if (total.sums.count("minor")) modes.push_back("minor");
+  for (map<string, vector<double> >::const_iterator it=total.sums.begin(); it!=total.sums.end(); ++it) {
+    if (it->first != "major" && it->first != "minor") modes.push_back(it->first);
+  }
+
+  KeyProfileSet profileSet;
+  for (int m=0; m<(int)modes.size(); m++) {
+    const vector<double>& sums = total.sums[modes[m]];
+    double maximum = *max_element(sums.begin(), sums.end());
+    if (maximum <= 0) continue;
+
+    vector<Real> profile(12);
+    for (int i=0; i<12; i++) profile[i] = sums[i] / maximum;
+    profileSet.labels.push_back(modes[m]);
+    profileSet.profiles.push_back(profile);
+
+    cout << modes[m] << " (" << total.counts[modes[m]] << " tracks):";
+    for (int i=0; i<12; i++) cout << " " << profile[i];
+    cout << endl;
+  }
+
+  cout << names.size() - skipped << " tracks used, " << skipped << " skipped" << endl;
+
+  if (profileSet.numModes() == 0) {
+    cout << "Error: no annotated tracks" << endl;
+    exit(1);
+  }
+
+  try {
+    writeProfileSet(outputFilename, profileSet);
+  }
+  catch (EssentiaException& e) {
+    cout << "Error: " << e.what() << endl;
+    exit(1);
+  }
+
+  return 0;
+}
@@ -0,0 +1,689 @@
+/*
+ * Copyright (C) 2006-2016  Music Technology Group - Universitat Pompeu Fabra
+ *
+ * This file is part of Essentia
+ *
+ * Essentia is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation (FSF), either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the Affero GNU General Public License
+ * version 3 along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+// Python bindings for the key matcher.
+//
+// The pcps are read in place through the buffer protocol (no copy is made,
+// so they must be C-contiguous arrays of Real), and the GIL is released
+// while correlating, so that several python threads can match at once.
+// Every call holds a reference to the matcher it uses, so calling __init__
+// again from another thread does not free it under a running match.
+//
+//   >>> import numpy as np, keymatcher
+//   >>> matcher = keymatcher.KeyMatcher(np.array([major, minor, other]), 36)
+//   >>> scores, shifts = matcher.match(chroma.astype('float32'))
+//
+// A pcp of shape (pcpSize,) returns scores of shape (profiles, pcpSize) and
+// shifts of shape (profiles,). A chromagram of shape (frames, pcpSize) returns
+// (frames, profiles, pcpSize) and (frames, profiles).
+//
+// key_scores(chroma) reduces the shifts of every semitone, returning
+// (frames, profiles * 12) key strengths, e.g. for framewise key plots.
+//
+// KeyIndex wraps KeySimilarityIndex, to find the tracks that mix well with a
+// query track (see keySimilarityIndex.h). Keys are given as keyIndex + 12 for
+// minor keys, with keyIndex 0 for A as in the Key* algorithms:
+//
+//   >>> index = keymatcher.KeyIndex(36)
+//   >>> index.add(track_id, key, matcher.key_scores(pcp[np.newaxis])[0])
+//   >>> index.build()
+//   >>> index.search_compatible(query, key, 10)   # [(id, key, similarity), ...]
+//
+// Searches release the GIL. The index cannot be changed while a search is
+// running on it.
+
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include "keyMatcher.h"
+#include "keySimilarityIndex.h"
+#include <new>
+#include <string>
+
+using namespace std;
+using namespace essentia;
+
+#if PY_MAJOR_VERSION >= 3
+#define KEYMATCHER_MODINIT PyMODINIT_FUNC PyInit_keymatcher(void)
+#define KEYMATCHER_RETURN(m) return m
+#else
+#define KEYMATCHER_MODINIT PyMODINIT_FUNC initkeymatcher(void)
+#define KEYMATCHER_RETURN(m) return
+#endif
+
+static const char* realFormat = sizeof(Real) == sizeof(float) ? "f" : "d";
+static const int realType = sizeof(Real) == sizeof(float) ? NPY_FLOAT32 : NPY_FLOAT64;
+
+
+// A matcher shared by a KeyMatcher object and the calls running on it. The
+// count is only changed with the GIL held, so it needs no lock.
+struct SharedMatcher {
+  KeyMatcher* matcher;
+  int references;
+};
+
+typedef struct {
+  PyObject_HEAD
+  SharedMatcher* shared;
+} PyKeyMatcher;
+
+
+static SharedMatcher* acquireMatcher(PyKeyMatcher* self) {
+  if (self->shared == NULL) {
+    PyErr_SetString(PyExc_RuntimeError, "KeyMatcher is not initialized");
+    return NULL;
+  }
+  self->shared->references++;
+  return self->shared;
+}
+
+static void releaseMatcher(SharedMatcher* shared) {
+  if (shared != NULL && --shared->references == 0) {
+    delete shared->matcher;
+    delete shared;
+  }
+}
+
+
+// Sets the python exception of a C++ exception caught while the GIL was
+// released: 'error' is empty for std::bad_alloc.
+static void setCppError(const string& error) {
+  if (error.empty()) PyErr_NoMemory();
+  else PyErr_SetString(PyExc_RuntimeError, error.c_str());
+}
+
+
+// Gets a read-only, C-contiguous view on a buffer of Real with 1 or 2
+// dimensions. Returns false with a python exception set otherwise.
+static bool getRealBuffer(PyObject* obj, Py_buffer* view) {
+  if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) {
+    return false;
+  }
+  if (view->format == NULL || string(view->format).find(realFormat) == string::npos ||
+      view->itemsize != sizeof(Real)) {
+    PyBuffer_Release(view);
+    PyErr_Format(PyExc_TypeError, "expected a buffer of %s, use numpy.ascontiguousarray(x, dtype='%s')",
+                 sizeof(Real) == sizeof(float) ? "float32" : "float64",
+                 sizeof(Real) == sizeof(float) ? "float32" : "float64");
+    return false;
+  }
+  if (view->ndim != 1 && view->ndim != 2) {
+    PyBuffer_Release(view);
+    PyErr_SetString(PyExc_ValueError, "expected a 1 or 2 dimensional buffer");
+    return false;
+  }
+  return true;
+}
+
+
+static int KeyMatcher_init(PyKeyMatcher* self, PyObject* args, PyObject* kwds) {
+  static const char* kwlist[] = { "profiles", "pcp_size", NULL };
+  PyObject* profilesObj;
+  int pcpSize = 12;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|i", (char**)kwlist, &profilesObj, &pcpSize)) {
+    return -1;
+  }
+
+  Py_buffer view;
+  if (!getRealBuffer(profilesObj, &view)) return -1;
+
+  if (view.ndim != 2 || view.shape[1] != 12) {
+    PyBuffer_Release(&view);
+    PyErr_SetString(PyExc_ValueError, "profiles must have shape (number of profiles, 12)");
+    return -1;
+  }
+
+  const Real* data = (const Real*)view.buf;
+  SharedMatcher* shared = NULL;
+  try {
+    vector<vector<Real> > profiles(view.shape[0]);
+    for (int p=0; p<(int)view.shape[0]; p++) {
+      profiles[p].assign(data + p*12, data + (p+1)*12);
+    }
+    shared = new SharedMatcher;
+    shared->matcher = NULL;
+    shared->references = 1;
+    shared->matcher = new KeyMatcher(profiles, pcpSize);
+  }
+  catch (EssentiaException& e) {
+    delete shared;
+    PyBuffer_Release(&view);
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return -1;
+  }
+  catch (std::bad_alloc&) {
+    delete shared;
+    PyBuffer_Release(&view);
+    PyErr_NoMemory();
+    return -1;
+  }
+  PyBuffer_Release(&view);
+
+  // calls still running on the previous matcher keep it alive
+  releaseMatcher(self->shared);
+  self->shared = shared;
+  return 0;
+}
+
+
+static void KeyMatcher_dealloc(PyKeyMatcher* self) {
+  releaseMatcher(self->shared);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+static PyObject* KeyMatcher_match(PyKeyMatcher* self, PyObject* args) {
+  PyObject* pcpObj;
+  if (!PyArg_ParseTuple(args, "O", &pcpObj)) return NULL;
+
+  SharedMatcher* shared = acquireMatcher(self);
+  if (shared == NULL) return NULL;
+  const KeyMatcher& matcher = *shared->matcher;
+  int pcpSize = matcher.pcpSize();
+  int numProfiles = matcher.numProfiles();
+
+  Py_buffer view;
+  if (!getRealBuffer(pcpObj, &view)) {
+    releaseMatcher(shared);
+    return NULL;
+  }
+
+  bool framewise = view.ndim == 2;
+  npy_intp frames = framewise ? view.shape[0] : 1;
+
+  if (view.shape[view.ndim-1] != pcpSize) {
+    PyBuffer_Release(&view);
+    releaseMatcher(shared);
+    PyErr_Format(PyExc_ValueError, "expected pcps of size %d", pcpSize);
+    return NULL;
+  }
+
+  npy_intp scoresShape[3] = { frames, numProfiles, pcpSize };
+  npy_intp shiftsShape[2] = { frames, numProfiles };
+  PyArrayObject* scores = (PyArrayObject*)PyArray_SimpleNew(framewise ? 3 : 2, framewise ? scoresShape : scoresShape + 1, realType);
+  PyArrayObject* shifts = (PyArrayObject*)PyArray_SimpleNew(framewise ? 2 : 1, framewise ? shiftsShape : shiftsShape + 1, NPY_INT);
+  if (scores == NULL || shifts == NULL) {
+    Py_XDECREF(scores);
+    Py_XDECREF(shifts);
+    PyBuffer_Release(&view);
+    releaseMatcher(shared);
+    return NULL;
+  }
+
+  const Real* pcp = (const Real*)view.buf;
+  Real* scoresData = (Real*)PyArray_DATA(scores);
+  int* shiftsData = (int*)PyArray_DATA(shifts);
+  bool failed = false;
+  string error;
+
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    for (npy_intp f=0; f<frames; f++) {
+      Real* frameScores = scoresData + f*numProfiles*pcpSize;
+      matcher.correlate(pcp + f*pcpSize, frameScores);
+      matcher.bestShifts(frameScores, shiftsData + f*numProfiles);
+    }
+  }
+  catch (std::bad_alloc&) {
+    failed = true;
+  }
+  catch (std::exception& e) {
+    failed = true;
+    error = e.what();
+  }
+  Py_END_ALLOW_THREADS
+
+  PyBuffer_Release(&view);
+  releaseMatcher(shared);
+  if (failed) {
+    Py_DECREF(scores);
+    Py_DECREF(shifts);
+    setCppError(error);
+    return NULL;
+  }
+  return Py_BuildValue("NN", scores, shifts);
+}
+
+
+static PyObject* KeyMatcher_keyScores(PyKeyMatcher* self, PyObject* args) {
+  PyObject* chromaObj;
+  if (!PyArg_ParseTuple(args, "O", &chromaObj)) return NULL;
+
+  SharedMatcher* shared = acquireMatcher(self);
+  if (shared == NULL) return NULL;
+  const KeyMatcher& matcher = *shared->matcher;
+  int pcpSize = matcher.pcpSize();
+  int numProfiles = matcher.numProfiles();
+
+  Py_buffer view;
+  if (!getRealBuffer(chromaObj, &view)) {
+    releaseMatcher(shared);
+    return NULL;
+  }
+
+  if (view.ndim != 2 || view.shape[1] != pcpSize) {
+    PyBuffer_Release(&view);
+    releaseMatcher(shared);
+    PyErr_Format(PyExc_ValueError, "expected a chromagram of shape (frames, %d)", pcpSize);
+    return NULL;
+  }
+  npy_intp frames = view.shape[0];
+
+  npy_intp shape[2] = { frames, numProfiles*12 };
+  PyArrayObject* keyScores = (PyArrayObject*)PyArray_SimpleNew(2, shape, realType);
+  // the scratch scores are allocated with the GIL held, so that a failure
+  // is reported as a python MemoryError
+  npy_intp scoresShape[1] = { frames * numProfiles * pcpSize };
+  PyArrayObject* scores = (PyArrayObject*)PyArray_SimpleNew(1, scoresShape, realType);
+  if (keyScores == NULL || scores == NULL) {
+    Py_XDECREF(keyScores);
+    Py_XDECREF(scores);
+    PyBuffer_Release(&view);
+    releaseMatcher(shared);
+    return NULL;
+  }
+
+  const Real* chroma = (const Real*)view.buf;
+  Real* keyScoresData = (Real*)PyArray_DATA(keyScores);
+  Real* scoresData = (Real*)PyArray_DATA(scores);
+  bool failed = false;
+  string error;
+
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    if (frames > 0) matcher.correlateFrames(chroma, (int)frames, scoresData);
+    for (npy_intp f=0; f<frames; f++) {
+      matcher.keyScores(scoresData + f*numProfiles*pcpSize, keyScoresData + f*numProfiles*12);
+    }
+  }
+  catch (std::bad_alloc&) {
+    failed = true;
+  }
+  catch (std::exception& e) {
+    failed = true;
+    error = e.what();
+  }
+  Py_END_ALLOW_THREADS
+
+  PyBuffer_Release(&view);
+  releaseMatcher(shared);
+  Py_DECREF(scores);
+  if (failed) {
+    Py_DECREF(keyScores);
+    setCppError(error);
+    return NULL;
+  }
+  return (PyObject*)keyScores;
+}
+
+
+static PyObject* KeyMatcher_getPcpSize(PyKeyMatcher* self, void*) {
+  return Py_BuildValue("i", self->shared ? self->shared->matcher->pcpSize() : 0);
+}
+
+static PyObject* KeyMatcher_getNumProfiles(PyKeyMatcher* self, void*) {
+  return Py_BuildValue("i", self->shared ? self->shared->matcher->numProfiles() : 0);
+}
+
+
+static PyMethodDef KeyMatcher_methods[] = {
+  { "match", (PyCFunction)KeyMatcher_match, METH_VARARGS,
+    "match(pcp) -> (scores, shifts)\n\n"
+    "Correlates a pcp, or every row of a chromagram, with all the profiles at every shift." },
+  { "key_scores", (PyCFunction)KeyMatcher_keyScores, METH_VARARGS,
+    "key_scores(chroma) -> scores\n\n"
+    "Best correlation of every profile for every tonic in every frame of a chromagram,\n"
+    "as an array of shape (frames, profiles * 12)." },
+  { NULL, NULL, 0, NULL }
+};
+
+static PyGetSetDef KeyMatcher_getset[] = {
+  { (char*)"pcp_size", (getter)KeyMatcher_getPcpSize, NULL, (char*)"size of the pcps to match", NULL },
+  { (char*)"num_profiles", (getter)KeyMatcher_getNumProfiles, NULL, (char*)"number of key profiles", NULL },
+  { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyTypeObject PyKeyMatcherType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "keymatcher.KeyMatcher",        // tp_name
+  sizeof(PyKeyMatcher),           // tp_basicsize
+};
+
+
+// An index and the number of searches running on it. Both are only used
+// with the GIL held, so they need no lock.
+typedef struct {
+  PyObject_HEAD
+  KeySimilarityIndex* index;
+  int searches;
+} PyKeyIndex;
+
+
+// Returns false with a python exception set if the index cannot be changed.
+static bool modifiableIndex(PyKeyIndex* self) {
+  if (self->index == NULL) {
+    PyErr_SetString(PyExc_RuntimeError, "KeyIndex is not initialized");
+    return false;
+  }
+  if (self->searches > 0) {
+    PyErr_SetString(PyExc_RuntimeError, "KeyIndex cannot be changed while it is searched");
+    return false;
+  }
+  return true;
+}
+
+
+// Gets a view on a single description of the dimension of the index.
+static bool getFeatures(PyKeyIndex* self, PyObject* obj, Py_buffer* view) {
+  if (!getRealBuffer(obj, view)) return false;
+  if (view->ndim != 1 || view->shape[0] != self->index->dimension()) {
+    PyBuffer_Release(view);
+    PyErr_Format(PyExc_ValueError, "expected a vector of size %d", self->index->dimension());
+    return false;
+  }
+  return true;
+}
+
+
+static int KeyIndex_init(PyKeyIndex* self, PyObject* args, PyObject* kwds) {
+  static const char* kwlist[] = { "dimension", NULL };
+  int dimension = 36;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", (char**)kwlist, &dimension)) {
+    return -1;
+  }
+  if (self->searches > 0) {
+    PyErr_SetString(PyExc_RuntimeError, "KeyIndex cannot be changed while it is searched");
+    return -1;
+  }
+
+  KeySimilarityIndex* index = NULL;
+  try {
+    index = new KeySimilarityIndex(dimension);
+  }
+  catch (EssentiaException& e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return -1;
+  }
+  catch (std::bad_alloc&) {
+    PyErr_NoMemory();
+    return -1;
+  }
+  delete self->index;
+  self->index = index;
+  return 0;
+}
+
+
+static void KeyIndex_dealloc(PyKeyIndex* self) {
+  delete self->index;
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+static PyObject* KeyIndex_add(PyKeyIndex* self, PyObject* args) {
+  unsigned int id;
+  int key;
+  PyObject* featuresObj;
+  if (!PyArg_ParseTuple(args, "IiO", &id, &key, &featuresObj)) return NULL;
+  if (!modifiableIndex(self)) return NULL;
+
+  Py_buffer view;
+  if (!getFeatures(self, featuresObj, &view)) return NULL;
+
+  try {
+    self->index->add((uint32_t)id, key, (const Real*)view.buf);
+  }
+  catch (EssentiaException& e) {
+    PyBuffer_Release(&view);
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+  catch (std::bad_alloc&) {
+    PyBuffer_Release(&view);
+    PyErr_NoMemory();
+    return NULL;
+  }
+  PyBuffer_Release(&view);
+  Py_RETURN_NONE;
+}
+
+
+static PyObject* KeyIndex_build(PyKeyIndex* self, PyObject*) {
+  if (!modifiableIndex(self)) return NULL;
+  try {
+    self->index->build();
+  }
+  catch (std::bad_alloc&) {
+    PyErr_NoMemory();
+    return NULL;
+  }
+  Py_RETURN_NONE;
+}
+
+
+// Runs a search with the GIL released, returning a list of
+// (id, key, similarity) tuples, best first. 'key' is -1 to search every key.
+static PyObject* searchIndex(PyKeyIndex* self, PyObject* queryObj, int key, int k) {
+  if (self->index == NULL) {
+    PyErr_SetString(PyExc_RuntimeError, "KeyIndex is not initialized");
+    return NULL;
+  }
+
+  Py_buffer view;
+  if (!getFeatures(self, queryObj, &view)) return NULL;
+
+  const KeySimilarityIndex& index = *self->index;
+  const Real* query = (const Real*)view.buf;
+  vector<KeyNeighbour> neighbours;
+  bool failed = false;
+  bool invalid = false;
+  string error;
+
+  self->searches++;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    if (key < 0) index.search(query, k, neighbours);
+    else index.searchCompatible(query, key, k, neighbours);
+  }
+  catch (std::bad_alloc&) {
+    failed = true;
+  }
+  catch (EssentiaException& e) {
+    failed = invalid = true;
+    error = e.what();
+  }
+  Py_END_ALLOW_THREADS
+  self->searches--;
+
+  PyBuffer_Release(&view);
+  if (failed) {
+    if (invalid) PyErr_SetString(PyExc_ValueError, error.c_str());
+    else setCppError(error);
+    return NULL;
+  }
+
+  PyObject* result = PyList_New(neighbours.size());
+  if (result == NULL) return NULL;
+  for (int n=0; n<(int)neighbours.size(); n++) {
+    PyObject* item = Py_BuildValue("(Iid)", (unsigned int)neighbours[n].id, neighbours[n].key,
+                                   (double)neighbours[n].similarity);
+    if (item == NULL) {
+      Py_DECREF(result);
+      return NULL;
+    }
+    PyList_SET_ITEM(result, n, item);
+  }
+  return result;
+}
+
+
+static PyObject* KeyIndex_search(PyKeyIndex* self, PyObject* args) {
+  PyObject* queryObj;
+  int k = 10;
+  if (!PyArg_ParseTuple(args, "O|i", &queryObj, &k)) return NULL;
+  return searchIndex(self, queryObj, -1, k);
+}
+
+
+static PyObject* KeyIndex_searchCompatible(PyKeyIndex* self, PyObject* args) {
+  PyObject* queryObj;
+  int key;
+  int k = 10;
+  if (!PyArg_ParseTuple(args, "Oi|i", &queryObj, &key, &k)) return NULL;
+  if (key < 0 || key >= KeySimilarityIndex::numBuckets) {
+    PyErr_SetString(PyExc_ValueError, "key must be in [0, 24)");
+    return NULL;
+  }
+  return searchIndex(self, queryObj, key, k);
+}
+
+
+static PyObject* KeyIndex_write(PyKeyIndex* self, PyObject* args) {
+  const char* filename;
+  if (!PyArg_ParseTuple(args, "s", &filename)) return NULL;
+  if (self->index == NULL) {
+    PyErr_SetString(PyExc_RuntimeError, "KeyIndex is not initialized");
+    return NULL;
+  }
+  try {
+    self->index->write(filename);
+  }
+  catch (EssentiaException& e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
+  Py_RETURN_NONE;
+}
+
+
+static PyObject* KeyIndex_read(PyKeyIndex* self, PyObject* args) {
+  const char* filename;
+  if (!PyArg_ParseTuple(args, "s", &filename)) return NULL;
+  if (!modifiableIndex(self)) return NULL;
+  try {
+    self->index->read(filename);
+  }
+  catch (EssentiaException& e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
+  catch (std::bad_alloc&) {
+    PyErr_NoMemory();
+    return NULL;
+  }
+  Py_RETURN_NONE;
+}
+
+
+static PyObject* KeyIndex_getDimension(PyKeyIndex* self, void*) {
+  return Py_BuildValue("i", self->index ? self->index->dimension() : 0);
+}
+
+static PyObject* KeyIndex_getSize(PyKeyIndex* self, void*) {
+  return Py_BuildValue("i", self->index ? self->index->size() : 0);
+}
+
+
+static PyMethodDef KeyIndex_methods[] = {
+  { "add", (PyCFunction)KeyIndex_add, METH_VARARGS,
+    "add(id, key, features)\n\n"
+    "Adds a track, with its key (keyIndex + 12 if minor) and description. Call build() before searching." },
+  { "build", (PyCFunction)KeyIndex_build, METH_NOARGS,
+    "build()\n\n"
+    "Makes the tracks added since the last call searchable." },
+  { "search", (PyCFunction)KeyIndex_search, METH_VARARGS,
+    "search(query, k=10) -> [(id, key, similarity), ...]\n\n"
+    "The k tracks most similar to a description, in any key." },
+  { "search_compatible", (PyCFunction)KeyIndex_searchCompatible, METH_VARARGS,
+    "search_compatible(query, key, k=10) -> [(id, key, similarity), ...]\n\n"
+    "The k tracks most similar to a description, in the keys that mix well with 'key':\n"
+    "the same key, a fifth up, a fifth down and the relative major or minor." },
+  { "write", (PyCFunction)KeyIndex_write, METH_VARARGS,
+    "write(filename)\n\n"
+    "Writes the index to a file." },
+  { "read", (PyCFunction)KeyIndex_read, METH_VARARGS,
+    "read(filename)\n\n"
+    "Replaces the index with the one of a file. The index is left unchanged if the file is invalid." },
+  { NULL, NULL, 0, NULL }
+};
+
+static PyGetSetDef KeyIndex_getset[] = {
+  { (char*)"dimension", (getter)KeyIndex_getDimension, NULL, (char*)"size of the track descriptions", NULL },
+  { (char*)"size", (getter)KeyIndex_getSize, NULL, (char*)"number of searchable tracks", NULL },
+  { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyTypeObject PyKeyIndexType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "keymatcher.KeyIndex",          // tp_name
+  sizeof(PyKeyIndex),             // tp_basicsize
+};
+
+
+static PyMethodDef module_methods[] = {
+  { NULL, NULL, 0, NULL }
+};
+
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef keymatchermodule = {
+  PyModuleDef_HEAD_INIT, "keymatcher", "Key profile matching on numpy buffers", -1, module_methods
+};
+#endif
+
+
+KEYMATCHER_MODINIT {
+  PyKeyMatcherType.tp_flags = Py_TPFLAGS_DEFAULT;
+  PyKeyMatcherType.tp_doc = "KeyMatcher(profiles, pcp_size=12)\n\n"
+                            "profiles: array of shape (number of profiles, 12)";
+  PyKeyMatcherType.tp_new = PyType_GenericNew;
+  PyKeyMatcherType.tp_init = (initproc)KeyMatcher_init;
+  PyKeyMatcherType.tp_dealloc = (destructor)KeyMatcher_dealloc;
+  PyKeyMatcherType.tp_methods = KeyMatcher_methods;
+  PyKeyMatcherType.tp_getset = KeyMatcher_getset;
+
+  PyKeyIndexType.tp_flags = Py_TPFLAGS_DEFAULT;
+  PyKeyIndexType.tp_doc = "KeyIndex(dimension=36)\n\n"
+                          "dimension: size of the track descriptions, e.g. 36 key scores";
+  PyKeyIndexType.tp_new = PyType_GenericNew;
+  PyKeyIndexType.tp_init = (initproc)KeyIndex_init;
+  PyKeyIndexType.tp_dealloc = (destructor)KeyIndex_dealloc;
+  PyKeyIndexType.tp_methods = KeyIndex_methods;
+  PyKeyIndexType.tp_getset = KeyIndex_getset;
+
+  if (PyType_Ready(&PyKeyMatcherType) < 0) KEYMATCHER_RETURN(NULL);
+  if (PyType_Ready(&PyKeyIndexType) < 0) KEYMATCHER_RETURN(NULL);
+
+#if PY_MAJOR_VERSION >= 3
+  PyObject* module = PyModule_Create(&keymatchermodule);
+#else
+  PyObject* module = Py_InitModule3("keymatcher", module_methods, "Key profile matching on numpy buffers");
+#endif
+  if (module == NULL) KEYMATCHER_RETURN(NULL);
+
+  import_array();
+
+  Py_INCREF(&PyKeyMatcherType);
+  PyModule_AddObject(module, "KeyMatcher", (PyObject*)&PyKeyMatcherType);
+  Py_INCREF(&PyKeyIndexType);
+  PyModule_AddObject(module, "KeyIndex", (PyObject*)&PyKeyIndexType);
+  KEYMATCHER_RETURN(module);
+}
@@ -1,4 +1,5 @@
 # coding=utf-8
+import struct
 import numpy as np
 from scipy.stats import pearsonr
 
@@ -13,80 +14,80 @@ key_names = ["C", "C#", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B"] #
 # key_names = ["A", "Bb", "B", "C", "C#", "D", "Eb", "E", "F", "F#", "G", "Ab"] # ESSENTIA
 
 
-def template_matching_2(pcp, profile_type='bgate'):
+TWO_PROFILE_TEMPLATES = {
 
-    key_templates = {
+'bgate': np.array([[1., 0.00, 0.42, 0.00, 0.53, 0.37, 0.00, 0.77, 0.00, 0.38, 0.21, 0.30],
+                   [1., 0.00, 0.36, 0.39, 0.00, 0.38, 0.00, 0.74, 0.27, 0.00, 0.42, 0.23]]),
 
-    'bgate': np.array([[1., 0.00, 0.42, 0.00, 0.53, 0.37, 0.00, 0.77, 0.00, 0.38, 0.21, 0.30],
-                       [1., 0.00, 0.36, 0.39, 0.00, 0.38, 0.00, 0.74, 0.27, 0.00, 0.42, 0.23]]),
+# almost identical to bgate. kept for backwards compatibility
+'bmtg3': np.array([[1.00, 0.00, 0.42, 0.00, 0.53, 0.37, 0.00, 0.76, 0.00, 0.38, 0.21, 0.30],
+                   [1.00, 0.00, 0.36, 0.39, 0.10, 0.37, 0.00, 0.76, 0.27, 0.00, 0.42, 0.23]]),
 
-    # almost identical to bgate. kept for backwards compatibility
-    'bmtg3': np.array([[1.00, 0.00, 0.42, 0.00, 0.53, 0.37, 0.00, 0.76, 0.00, 0.38, 0.21, 0.30],
-                       [1.00, 0.00, 0.36, 0.39, 0.10, 0.37, 0.00, 0.76, 0.27, 0.00, 0.42, 0.23]]),
+'bmtg2': np.array([[1.00, 0.10, 0.42, 0.10, 0.53, 0.37, 0.10, 0.77, 0.10, 0.38, 0.21, 0.30],
+                   [1.00, 0.10, 0.36, 0.39, 0.29, 0.38, 0.10, 0.74, 0.27, 0.10, 0.42, 0.23]]),
 
-    'bmtg2': np.array([[1.00, 0.10, 0.42, 0.10, 0.53, 0.37, 0.10, 0.77, 0.10, 0.38, 0.21, 0.30],
-                       [1.00, 0.10, 0.36, 0.39, 0.29, 0.38, 0.10, 0.74, 0.27, 0.10, 0.42, 0.23]]),
+# was originally bmtg1
+'braw': np.array([[1., 0.1573, 0.4200, 0.1570, 0.5296, 0.3669, 0.1632, 0.7711, 0.1676, 0.3827, 0.2113, 0.2965],
+                  [1., 0.2330, 0.3615, 0.3905, 0.2925, 0.3777, 0.1961, 0.7425, 0.2701, 0.2161, 0.4228, 0.2272]]),
 
-    # was originally bmtg1
-    'braw': np.array([[1., 0.1573, 0.4200, 0.1570, 0.5296, 0.3669, 0.1632, 0.7711, 0.1676, 0.3827, 0.2113, 0.2965],
-                      [1., 0.2330, 0.3615, 0.3905, 0.2925, 0.3777, 0.1961, 0.7425, 0.2701, 0.2161, 0.4228, 0.2272]]),
+'diatonic': np.array([[1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1],
+                      [1, 0, 1, 1, 0, 1, 0, 1, 1, 0, 0, 1]]),
 
-    'diatonic': np.array([[1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1],
-                          [1, 0, 1, 1, 0, 1, 0, 1, 1, 0, 0, 1]]),
+'monotonic': np.array([[1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0],
+                       [1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0]]),
 
-    'monotonic': np.array([[1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0],
-                           [1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0]]),
+'triads': np.array([[1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0],
+                    [1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0]]),
 
-    'triads': np.array([[1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0],
-                        [1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0]]),
+'edma_ecir': np.array([[0.16519551, 0.04749026, 0.08293076, 0.06687112, 0.09994645, 0.09274123, 0.05294487, 0.13159476, 0.05218986, 0.07443653, 0.06940723, 0.0642515],
+                       [0.17235348, 0.05336489, 0.0761009, 0.10043649, 0.05621498, 0.08527853, 0.0497915, 0.13451001, 0.07458916, 0.05003023, 0.09187879, 0.05545106]]),
 
-    'edma_ecir': np.array([[0.16519551, 0.04749026, 0.08293076, 0.06687112, 0.09994645, 0.09274123, 0.05294487, 0.13159476, 0.05218986, 0.07443653, 0.06940723, 0.0642515],
-                           [0.17235348, 0.05336489, 0.0761009, 0.10043649, 0.05621498, 0.08527853, 0.0497915, 0.13451001, 0.07458916, 0.05003023, 0.09187879, 0.05545106]]),
+'edmm_ecir': np.array([[0.083, 0.083, 0.083, 0.083, 0.083, 0.083, 0.083, 0.083, 0.083, 0.083, 0.083, 0.083],
+                       [0.17235348, 0.04, 0.0761009, 0.12, 0.05621498, 0.08527853, 0.0497915, 0.13451001, 0.07458916, 0.05003023, 0.09187879, 0.05545106]]),
 
-    'edmm_ecir': np.array([[0.083, 0.083, 0.083, 0.083, 0.083, 0.083, 0.083, 0.083, 0.083, 0.083, 0.083, 0.083],
-                           [0.17235348, 0.04, 0.0761009, 0.12, 0.05621498, 0.08527853, 0.0497915, 0.13451001, 0.07458916, 0.05003023, 0.09187879, 0.05545106]]),
+'edma':  np.array([[1., 0.2875, 0.5020, 0.4048, 0.6050, 0.5614, 0.3205, 0.7966, 0.3159, 0.4506, 0.4202, 0.3889],
+                   [1., 0.3096, 0.4415, 0.5827, 0.3262, 0.4948, 0.2889, 0.7804, 0.4328, 0.2903, 0.5331, 0.3217]]),
 
-    'edma':  np.array([[1., 0.2875, 0.5020, 0.4048, 0.6050, 0.5614, 0.3205, 0.7966, 0.3159, 0.4506, 0.4202, 0.3889],
-                       [1., 0.3096, 0.4415, 0.5827, 0.3262, 0.4948, 0.2889, 0.7804, 0.4328, 0.2903, 0.5331, 0.3217]]),
+'edmm':  np.array([[1., 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000],
+                   [1., 0.2321, 0.4415, 0.6962, 0.3262, 0.4948, 0.2889, 0.7804, 0.4328, 0.2903, 0.5331, 0.3217]]),
 
-    'edmm':  np.array([[1., 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000, 1.0000],
-                       [1., 0.2321, 0.4415, 0.6962, 0.3262, 0.4948, 0.2889, 0.7804, 0.4328, 0.2903, 0.5331, 0.3217]]),
+'krumhansl': np.array([[6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88],
+                       [6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17]]),
 
-    'krumhansl': np.array([[6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88],
-                           [6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17]]),
+'temperley99': np.array([[5.0, 2.0, 3.5, 2.0, 4.5, 4.0, 2.0, 4.5, 2.0, 3.5, 1.5, 4.0],
+                         [5.0, 2.0, 3.5, 4.5, 2.0, 4.0, 2.0, 4.5, 3.5, 2.0, 1.5, 4.0]]),
 
-    'temperley99': np.array([[5.0, 2.0, 3.5, 2.0, 4.5, 4.0, 2.0, 4.5, 2.0, 3.5, 1.5, 4.0],
-                             [5.0, 2.0, 3.5, 4.5, 2.0, 4.0, 2.0, 4.5, 3.5, 2.0, 1.5, 4.0]]),
+'temperley05': np.array([[0.748, 0.060, 0.488, 0.082, 0.67, 0.46, 0.096, 0.715, 0.104, 0.366, 0.057, 0.4],
+                         [0.712, 0.084, 0.474, 0.618, 0.049, 0.46, 0.105, 0.747, 0.404, 0.067, 0.133, 0.33]]),
 
-    'temperley05': np.array([[0.748, 0.060, 0.488, 0.082, 0.67, 0.46, 0.096, 0.715, 0.104, 0.366, 0.057, 0.4],
-                             [0.712, 0.084, 0.474, 0.618, 0.049, 0.46, 0.105, 0.747, 0.404, 0.067, 0.133, 0.33]]),
+'temperley-essen': np.array([[0.184, 0.001, 0.155, 0.003, 0.191, 0.109, 0.005, 0.214, 0.001, 0.078, 0.004, 0.055],
+                             [0.192, 0.005, 0.149, 0.179, 0.002, 0.144, 0.002, 0.201, 0.038, 0.012, 0.053, 0.022]]),
 
-    'temperley-essen': np.array([[0.184, 0.001, 0.155, 0.003, 0.191, 0.109, 0.005, 0.214, 0.001, 0.078, 0.004, 0.055],
-                                 [0.192, 0.005, 0.149, 0.179, 0.002, 0.144, 0.002, 0.201, 0.038, 0.012, 0.053, 0.022]]),
+'thpcp': np.array([[0.95162, 0.20742, 0.71758, 0.22007, 0.71341, 0.48841, 0.31431, 1.00000, 0.20957, 0.53657, 0.22585, 0.55363],
+                   [0.94409, 0.21742, 0.64525, 0.63229, 0.27897, 0.57709, 0.26428, 1.0000, 0.26428, 0.30633, 0.45924, 0.35929]]),
 
-    'thpcp': np.array([[0.95162, 0.20742, 0.71758, 0.22007, 0.71341, 0.48841, 0.31431, 1.00000, 0.20957, 0.53657, 0.22585, 0.55363],
-                       [0.94409, 0.21742, 0.64525, 0.63229, 0.27897, 0.57709, 0.26428, 1.0000, 0.26428, 0.30633, 0.45924, 0.35929]]),
+'shaath': np.array([[6.6, 2.0, 3.5, 2.3, 4.6, 4.0, 2.5, 5.2, 2.4, 3.7, 2.3, 3.4],
+                    [6.5, 2.7, 3.5, 5.4, 2.6, 3.5, 2.5, 5.2, 4.0, 2.7, 4.3, 3.2]]),
 
-    'shaath': np.array([[6.6, 2.0, 3.5, 2.3, 4.6, 4.0, 2.5, 5.2, 2.4, 3.7, 2.3, 3.4],
-                        [6.5, 2.7, 3.5, 5.4, 2.6, 3.5, 2.5, 5.2, 4.0, 2.7, 4.3, 3.2]]),
+'gomez': np.array([[0.82, 0.00, 0.55, 0.00, 0.53, 0.30, 0.08, 1.00, 0.00, 0.38, 0.00, 0.47],
+                   [0.81, 0.00, 0.53, 0.54, 0.00, 0.27, 0.07, 1.00, 0.27, 0.07, 0.10, 0.36]]),
 
-    'gomez': np.array([[0.82, 0.00, 0.55, 0.00, 0.53, 0.30, 0.08, 1.00, 0.00, 0.38, 0.00, 0.47],
-                       [0.81, 0.00, 0.53, 0.54, 0.00, 0.27, 0.07, 1.00, 0.27, 0.07, 0.10, 0.36]]),
+'faraldo': np.array([[7.0, 2.0, 3.8, 2.3, 4.7, 4.1, 2.5, 5.2, 2.0, 3.7, 3.0, 3.4],
+                     [7.0, 3.0, 3.8, 4.5, 2.6, 3.5, 2.5, 5.2, 4.0, 2.5, 4.5, 3.0]]),
 
-    'faraldo': np.array([[7.0, 2.0, 3.8, 2.3, 4.7, 4.1, 2.5, 5.2, 2.0, 3.7, 3.0, 3.4],
-                         [7.0, 3.0, 3.8, 4.5, 2.6, 3.5, 2.5, 5.2, 4.0, 2.5, 4.5, 3.0]]),
+'pentatonic': np.array([[1.0, 0.1, 0.25, 0.1, 0.5, 0.7, 0.1, 0.8, 0.1, 0.25, 0.1, 0.5],
+                        [1.0, 0.2, 0.25, 0.5, 0.1, 0.7, 0.1, 0.8, 0.3, 0.2, 0.6, 0.2]]),
 
-    'pentatonic': np.array([[1.0, 0.1, 0.25, 0.1, 0.5, 0.7, 0.1, 0.8, 0.1, 0.25, 0.1, 0.5],
-                            [1.0, 0.2, 0.25, 0.5, 0.1, 0.7, 0.1, 0.8, 0.3, 0.2, 0.6, 0.2]]),
+'noland': np.array([[0.0629, 0.0146, 0.061, 0.0121, 0.0623, 0.0414, 0.0248, 0.0631, 0.015, 0.0521, 0.0142, 0.0478],
+                    [0.0682, 0.0138, 0.0543, 0.0519, 0.0234, 0.0544, 0.0176, 0.067, 0.0349, 0.0297, 0.0401, 0.027]])
+}
 
-    'noland': np.array([[0.0629, 0.0146, 0.061, 0.0121, 0.0623, 0.0414, 0.0248, 0.0631, 0.015, 0.0521, 0.0142, 0.0478],
-                        [0.0682, 0.0138, 0.0543, 0.0519, 0.0234, 0.0544, 0.0176, 0.067, 0.0349, 0.0297, 0.0401, 0.027]])
-    }
 
+def template_matching_2(pcp, profile_type='bgate', temperature=None):
     if (pcp.size < 12) or (pcp.size % 12 != 0):
         raise IndexError("Input PCP size is not a positive multiple of 12")
 
-    _major, _minor = _select_profile_type(profile_type, key_templates)
+    _major, _minor = _select_profile_type(profile_type, TWO_PROFILE_TEMPLATES)
 
     first_max_major = -1
     second_max_major = -1
@@ -129,39 +130,46 @@ def template_matching_2(pcp, profile_type='bgate'):
         raise IndexError("key_index smaller than zero. Could not find key.")
     else:
         first_to_second_ratio = (first_max - second_max) / first_max
-        return key_names[int(key_index)], scale, first_max, first_to_second_ratio
+        estimation = key_names[int(key_index)], scale, first_max, first_to_second_ratio
+        if temperature is not None:
+            # extended with the probability of the key (see key_probability)
+            correlations = profile_correlations(pcp, [_major, _minor])
+            estimation += (key_probability(correlations, ('major', 'minor'), scale,
+                                           int(key_index) * 12 // pcp.size, temperature),)
+        return estimation
 
 
-def template_matching_3(pcp, profile_type='bgate'):
-    if (pcp.size < 12) or (pcp.size % 12 != 0):
-        raise IndexError("Input PCP size is not a positive multiple of 12")
+THREE_PROFILE_TEMPLATES = {
 
-    key_templates = {
+'bgate': np.array([[1., 0.00, 0.42, 0.00, 0.53, 0.37, 0.00, 0.77, 0.00, 0.38, 0.21, 0.30],
+                   [1., 0.00, 0.36, 0.39, 0.00, 0.38, 0.00, 0.74, 0.27, 0.00, 0.42, 0.23],
+                   [1., 0.26, 0.35, 0.29, 0.44, 0.36, 0.21, 0.78, 0.26, 0.25, 0.32, 0.26]]),
 
-    'bgate': np.array([[1., 0.00, 0.42, 0.00, 0.53, 0.37, 0.00, 0.77, 0.00, 0.38, 0.21, 0.30],
-                       [1., 0.00, 0.36, 0.39, 0.00, 0.38, 0.00, 0.74, 0.27, 0.00, 0.42, 0.23],
-                       [1., 0.26, 0.35, 0.29, 0.44, 0.36, 0.21, 0.78, 0.26, 0.25, 0.32, 0.26]]),
+# almost identical to bgate, predecessor.
+'bmtg3': np.array([[1., 0.00, 0.42, 0.00, 0.53, 0.37, 0.00, 0.76, 0.00, 0.38, 0.21, 0.30],
+                   [1., 0.00, 0.36, 0.39, 0.10, 0.37, 0.00, 0.76, 0.27, 0.00, 0.42, 0.23],
+                   [1., 0.26, 0.35, 0.29, 0.44, 0.37, 0.21, 0.76, 0.26, 0.25, 0.32, 0.26]]),
 
-    # almost identical to bgate, predecessor.
-    'bmtg3': np.array([[1., 0.00, 0.42, 0.00, 0.53, 0.37, 0.00, 0.76, 0.00, 0.38, 0.21, 0.30],
-                       [1., 0.00, 0.36, 0.39, 0.10, 0.37, 0.00, 0.76, 0.27, 0.00, 0.42, 0.23],
-                       [1., 0.26, 0.35, 0.29, 0.44, 0.37, 0.21, 0.76, 0.26, 0.25, 0.32, 0.26]]),
+'bmtg2': np.array([[1., 0.10, 0.42, 0.10, 0.53, 0.37, 0.10, 0.77, 0.10, 0.38, 0.21, 0.30],
+                   [1., 0.10, 0.36, 0.39, 0.29, 0.38, 0.10, 0.74, 0.27, 0.10, 0.42, 0.23],
+                   [1., 0.26, 0.35, 0.29, 0.44, 0.36, 0.21, 0.78, 0.26, 0.25, 0.32, 0.26]]),
 
-    'bmtg2': np.array([[1., 0.10, 0.42, 0.10, 0.53, 0.37, 0.10, 0.77, 0.10, 0.38, 0.21, 0.30],
-                       [1., 0.10, 0.36, 0.39, 0.29, 0.38, 0.10, 0.74, 0.27, 0.10, 0.42, 0.23],
-                       [1., 0.26, 0.35, 0.29, 0.44, 0.36, 0.21, 0.78, 0.26, 0.25, 0.32, 0.26]]),
+# was bmtg1
+'braw':  np.array([[1., 0.1573, 0.4200, 0.1570, 0.5296, 0.3669, 0.1632, 0.7711, 0.1676, 0.3827, 0.2113, 0.2965],
+                   [1., 0.2330, 0.3615, 0.3905, 0.2925, 0.3777, 0.1961, 0.7425, 0.2701, 0.2161, 0.4228, 0.2272],
+                   [1., 0.2608, 0.3528, 0.2935, 0.4393, 0.3580, 0.2137, 0.7809, 0.2578, 0.2539, 0.3233, 0.2615]]),
 
-    # was bmtg1
-    'braw':  np.array([[1., 0.1573, 0.4200, 0.1570, 0.5296, 0.3669, 0.1632, 0.7711, 0.1676, 0.3827, 0.2113, 0.2965],
-                       [1., 0.2330, 0.3615, 0.3905, 0.2925, 0.3777, 0.1961, 0.7425, 0.2701, 0.2161, 0.4228, 0.2272],
-                       [1., 0.2608, 0.3528, 0.2935, 0.4393, 0.3580, 0.2137, 0.7809, 0.2578, 0.2539, 0.3233, 0.2615]]),
+'edma':  np.array([[1.00, 0.29, 0.50, 0.40, 0.60, 0.56, 0.32, 0.80, 0.31, 0.45, 0.42, 0.39],
+                   [1.00, 0.31, 0.44, 0.58, 0.33, 0.49, 0.29, 0.78, 0.43, 0.29, 0.53, 0.32],
+                   [1.00, 0.26, 0.35, 0.29, 0.44, 0.36, 0.21, 0.78, 0.26, 0.25, 0.32, 0.26]])
+}
 
-    'edma':  np.array([[1.00, 0.29, 0.50, 0.40, 0.60, 0.56, 0.32, 0.80, 0.31, 0.45, 0.42, 0.39],
-                       [1.00, 0.31, 0.44, 0.58, 0.33, 0.49, 0.29, 0.78, 0.43, 0.29, 0.53, 0.32],
-                       [1.00, 0.26, 0.35, 0.29, 0.44, 0.36, 0.21, 0.78, 0.26, 0.25, 0.32, 0.26]])
-    }
 
-    _major, _minor, _minor2 = _select_profile_type(profile_type, key_templates)
+def template_matching_3(pcp, profile_type='bgate', temperature=None):
+    if (pcp.size < 12) or (pcp.size % 12 != 0):
+        raise IndexError("Input PCP size is not a positive multiple of 12")
+
+    _major, _minor, _minor2 = _select_profile_type(profile_type, THREE_PROFILE_TEMPLATES)
 
     first_max_major   = -1
     second_max_major  = -1
@@ -222,30 +230,39 @@ def template_matching_3(pcp, profile_type='bgate'):
         raise IndexError("key_index smaller than zero. Could not find key.")
     else:
         first_to_second_ratio = (first_max - second_max) / first_max
-        return key_names[int(key_index)], scale, first_max, first_to_second_ratio
+        estimation = key_names[int(key_index)], scale, first_max, first_to_second_ratio
+        if temperature is not None:
+            # extended with the probability of the key (see key_probability)
+            correlations = profile_correlations(pcp, [_major, _minor, _minor2])
+            estimation += (key_probability(correlations, THREE_PROFILE_SCALES, scale,
+                                           int(key_index) * 12 // pcp.size, temperature),)
+        return estimation
 
 
-def template_matching_modal(pcp):
-    if (pcp.size < 12) or (pcp.size % 12 != 0):
-        raise IndexError("Input PCP size is not a positive multiple of 12")
+_MODAL_ORDER = ['ionian', 'harmonic', 'mixolydian', 'phrygian', 'fifth', 'monotonic', 'difficult']
+
+MODAL_TEMPLATES = {
 
-    key_templates = {
+    'ionian': np.array([1.00, 0.10, 0.43, 0.14, 0.61, 0.38, 0.12, 0.78, 0.13, 0.46, 0.15, 0.60]),
 
-        'ionian': np.array([1.00, 0.10, 0.43, 0.14, 0.61, 0.38, 0.12, 0.78, 0.13, 0.46, 0.15, 0.60]),
+    'harmonic': np.array([1.00, 0.10, 0.36, 0.37, 0.22, 0.33, 0.18, 0.75, 0.25, 0.18, 0.37, 0.37]),
 
-        'harmonic': np.array([1.00, 0.10, 0.36, 0.37, 0.22, 0.33, 0.18, 0.75, 0.25, 0.18, 0.37, 0.37]),
+    'mixolydian': np.array([1.00, 0.10, 0.42, 0.10, 0.55, 0.40, 0.10, 0.77, 0.10, 0.42, 0.66, 0.15]),
 
-        'mixolydian': np.array([1.00, 0.10, 0.42, 0.10, 0.55, 0.40, 0.10, 0.77, 0.10, 0.42, 0.66, 0.15]),
+    'phrygian': np.array([1.00, 0.47, 0.10, 0.36, 0.24, 0.37, 0.16, 0.76, 0.30, 0.20, 0.45, 0.23]),
 
-        'phrygian': np.array([1.00, 0.47, 0.10, 0.36, 0.24, 0.37, 0.16, 0.76, 0.30, 0.20, 0.45, 0.23]),
+    'fifth': np.array([1.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.65, 0.00, 0.00, 0.00, 0.00]),
 
-        'fifth': np.array([1.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.65, 0.00, 0.00, 0.00, 0.00]),
+    'monotonic': np.array([1.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00]),
 
-        'monotonic': np.array([1.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00]),
+    'difficult': np.array([0.80, 0.60, 0.80, 0.60, 0.80, 0.60, 0.80, 0.60, 0.80, 0.60, 0.80, 0.60]),
 
-        'difficult': np.array([0.80, 0.60, 0.80, 0.60, 0.80, 0.60, 0.80, 0.60, 0.80, 0.60, 0.80, 0.60]),
+}
 
-    }
+
+def template_matching_modal(pcp):
+    if (pcp.size < 12) or (pcp.size % 12 != 0):
+        raise IndexError("Input PCP size is not a positive multiple of 12")
 
     first_max_ionian      = -1
     second_max_ionian     = -1
@@ -276,43 +293,43 @@ def template_matching_modal(pcp):
     key_index_difficult   = -1
 
     for shift in np.arange(pcp.size):
-        correlation_ionian = (pearsonr(pcp, np.roll(key_templates['ionian'], shift)))[0]
+        correlation_ionian = (pearsonr(pcp, np.roll(MODAL_TEMPLATES['ionian'], shift)))[0]
         if correlation_ionian > first_max_ionian:
             second_max_ionian = first_max_ionian
             first_max_ionian = correlation_ionian
             key_index_ionian = shift
 
-        correlation_harmonic = (pearsonr(pcp, np.roll(key_templates['harmonic'], shift)))[0]
+        correlation_harmonic = (pearsonr(pcp, np.roll(MODAL_TEMPLATES['harmonic'], shift)))[0]
         if correlation_harmonic > first_max_harmonic:
             second_max_harmonic = first_max_harmonic
             first_max_harmonic = correlation_harmonic
             key_index_harmonic = shift
 
-        correlation_mixolydian = (pearsonr(pcp, np.roll(key_templates['mixolydian'], shift)))[0]
+        correlation_mixolydian = (pearsonr(pcp, np.roll(MODAL_TEMPLATES['mixolydian'], shift)))[0]
         if correlation_mixolydian > first_max_mixolydian:
             second_max_mixolydian = first_max_mixolydian
             first_max_mixolydian = correlation_mixolydian
             key_index_mixolydian = shift
 
-        correlation_phrygian = (pearsonr(pcp, np.roll(key_templates['phrygian'], shift)))[0]
+        correlation_phrygian = (pearsonr(pcp, np.roll(MODAL_TEMPLATES['phrygian'], shift)))[0]
         if correlation_phrygian > first_max_phrygian:
             second_max_phrygian = first_max_phrygian
             first_max_phrygian = correlation_phrygian
             key_index_phrygian = shift
 
-        correlation_fifth = (pearsonr(pcp, np.roll(key_templates['fifth'], shift)))[0]
+        correlation_fifth = (pearsonr(pcp, np.roll(MODAL_TEMPLATES['fifth'], shift)))[0]
         if correlation_fifth > first_max_fifth:
             second_max_fifth = first_max_fifth
             first_max_fifth = correlation_fifth
             key_index_fifth = shift
 
-        correlation_monotonic = (pearsonr(pcp, np.roll(key_templates['monotonic'], shift)))[0]
+        correlation_monotonic = (pearsonr(pcp, np.roll(MODAL_TEMPLATES['monotonic'], shift)))[0]
         if correlation_monotonic > first_max_monotonic:
             second_max_monotonic = first_max_monotonic
             first_max_monotonic = correlation_monotonic
             key_index_monotonic = shift
 
-        correlation_difficult = (pearsonr(pcp, np.roll(key_templates['difficult'], shift)))[0]
+        correlation_difficult = (pearsonr(pcp, np.roll(MODAL_TEMPLATES['difficult'], shift)))[0]
         if correlation_difficult > first_max_difficult:
             second_max_difficult = first_max_difficult
             first_max_difficult = correlation_difficult
@@ -389,8 +406,200 @@ def template_matching_modal(pcp):
         return key_names[int(key_index)], scale, first_max, first_to_second_ratio
 
 
+def interpolate_profile(profile, pcp_size):
+    """
+    Resizes a 12-bin profile to pcp_size bins (a multiple of 12) by linear
+    interpolation between semitones, as KeyMatcher::interpolate does.
+    :type profile: np.ndarray (12 bins)
+    :type pcp_size: int
+    """
+    n = pcp_size // 12
+    profile = np.asarray(profile, dtype=float)
+    resized = np.empty(pcp_size)
+    for i in range(12):
+        step = (profile[11] - profile[0]) / n if i == 11 else (profile[i] - profile[i + 1]) / n
+        resized[i * n:(i + 1) * n] = profile[i] - np.arange(n) * step
+    return resized
+
+
+def profile_correlations(pcp, profiles):
+    """
+    Pearson correlation of a pcp with every profile at every shift, as a
+    (profiles, pcp size) array: correlations[p, shift] is the correlation
+    with np.roll(profiles[p], shift), the profiles being interpolated to
+    the size of the pcp (a multiple of 12) as in KeyEDM3.
+    Raises IndexError on a flat pcp, which correlates with nothing.
+    :type pcp: np.ndarray (12 * n bins)
+    :type profiles: np.ndarray (profiles, 12)
+    """
+    size = len(pcp)
+    if size < 12 or size % 12 != 0:
+        raise IndexError("Input PCP size is not a positive multiple of 12")
+    profiles = [interpolate_profile(profile, size) for profile in profiles]
+    rolled = np.array([[np.roll(profile, shift) for shift in range(size)] for profile in profiles], dtype=float)
+    rolled -= rolled.mean(axis=2)[:, :, np.newaxis]
+    rolled /= np.sqrt((rolled ** 2).sum(axis=2))[:, :, np.newaxis]
+    pcp = np.asarray(pcp, dtype=float) - np.mean(pcp)
+    norm = np.sqrt(np.dot(pcp, pcp))
+    if norm == 0:
+        raise IndexError("key_index smaller than zero. Could not find key.")
+    return np.dot(rolled, pcp / norm)
+
+
+# scale reported for each of the three profiles, the 'other' profile as minor
+THREE_PROFILE_SCALES = ('major', 'minor', 'minor')
+
+
+def key_probabilities(correlations, temperature=0.05):
+    """
+    Calibrated probability of every profile and tonic, as a (profiles, 12)
+    array: a softmax of all the correlations (as returned by
+    profile_correlations) with the given temperature, with the shifts of
+    each semitone added together, as KeyMatcher::keyProbabilities does.
+    :type correlations: np.ndarray (profiles, 12 * n)
+    :type temperature: float
+    """
+    correlations = np.asarray(correlations, dtype=float)
+    weights = np.exp((correlations - np.max(correlations)) / temperature)
+    weights = weights.reshape(len(correlations), 12, -1).sum(axis=2)
+    return weights / np.sum(weights)
+
+
+def key_probability(correlations, scales, scale, tonic, temperature=0.05):
+    """
+    Calibrated probability of a key, as KeyEDM3 and KeyEDMEnsemble report
+    it: the probabilities of its tonic with every profile reported with its
+    scale (e.g. minor and other) added together.
+    :type correlations: np.ndarray (profiles, 12 * n), as returned by profile_correlations
+    :type scales: sequence of str, the scale reported for every profile
+    :type scale: str
+    :type tonic: int (index of the tonic in the columns of key_probabilities)
+    :type temperature: float
+    """
+    probabilities = key_probabilities(correlations, temperature)
+    return float(sum(probabilities[p, tonic] for p in range(len(scales)) if scales[p] == scale))
+
+
+def fit_key_temperature(correlation_sets, true_keys, scales=THREE_PROFILE_SCALES,
+                        temperatures=np.logspace(-3, 0, 301)):
+    """
+    Fits the softmax temperature of the key probability on annotated tracks,
+    as the one with the lowest negative log likelihood of the true keys.
+    The correlations must be computed on pcps of the size given to KeyEDM3
+    (e.g. 36 bins), so that the shifts of each semitone are added as they
+    are there.
+    :type correlation_sets: sequence of np.ndarray (profiles, pcp size), as returned by profile_correlations, one per track
+    :type true_keys: sequence of (scale, tonic index) tuples, one per track
+    :type scales: sequence of str, the scale reported for every profile
+    :type temperatures: sequence of candidate temperatures
+    """
+    best_temperature, best_loss = None, np.inf
+    for temperature in temperatures:
+        loss = 0
+        for correlations, (scale, tonic) in zip(correlation_sets, true_keys):
+            loss -= np.log(max(key_probability(correlations, scales, scale, tonic, temperature), 1e-300))
+        if loss < best_loss:
+            best_temperature, best_loss = temperature, loss
+    return best_temperature
+
+
+def template_matching_ensemble(pcp, profile_type='bgate', override_modes=('monotonic',), override_scale='minor',
+                               temperature=0.05):
+    """
+    Estimates the key with the three profiles of template_matching_3 and the
+    modal profiles of template_matching_modal in a single pass: the pcp is
+    centred and normalised once and correlated with every rotated profile
+    in one matrix product.
+    The scale is override_scale when the modal estimation is one of
+    override_modes on the same tonic (monotonic tracks to minor by default).
+    Returns the tonic, the fused scale and the estimations of
+    template_matching_3 and template_matching_modal, the first one extended
+    with the probability of its key (see key_probability).
+    :type pcp: np.ndarray (12 bins)
+    :type profile_type: str
+    :type override_modes: sequence of str
+    :type override_scale: str
+    :type temperature: float
+    """
+    if pcp.size != 12:
+        raise IndexError("Input PCP size is not 12")
+
+    modes = _MODAL_ORDER
+    profiles = np.vstack([_select_profile_type(profile_type, THREE_PROFILE_TEMPLATES)] +
+                         [MODAL_TEMPLATES[mode] for mode in modes]).astype(float)
+    correlations = profile_correlations(pcp, profiles)
+
+    def estimation(p, label):
+        key_index = int(np.argmax(correlations[p]))
+        first_max = correlations[p, key_index]
+        # as in the loops above, the second max is the best one found before the first
+        second_max = correlations[p, :key_index].max() if key_index > 0 else -1
+        return key_names[key_index], label, first_max, (first_max - second_max) / first_max
+
+    maxima = correlations.max(axis=1)
+    primary = int(np.argmax(maxima[:3]))
+    if maxima[1] >= maxima[primary]:
+        primary = 1
+    estimation_1 = estimation(primary, THREE_PROFILE_SCALES[primary])
+    estimation_1 += (key_probability(correlations[:3], THREE_PROFILE_SCALES, estimation_1[1],
+                                     int(np.argmax(correlations[primary])), temperature),)
+    modal = int(np.argmax(maxima[3:]))
+    estimation_2 = estimation(3 + modal, modes[modal])
+
+    scale = estimation_1[1]
+    if estimation_2[1] in override_modes and estimation_2[0] == estimation_1[0]:
+        scale = override_scale
+    return estimation_1[0], scale, estimation_1, estimation_2
+
+
 def _select_profile_type(profile, templates_dict):
     try:
         return templates_dict[profile]
     except:
         raise KeyError("Unsupported profile: {0}\nvalid profiles are:\n{1}".format(profile, templates_dict.keys()))
+
+
+def write_profile_file(filename, profiles, labels=('major', 'minor', 'other')):
+    """
+    Writes a set of key profiles (one row of 12 values per mode, starting
+    on the tonic) to a file that KeyEDM3 can load with its 'profileFile'
+    parameter. See keyProfiles.h for the layout.
+    :type filename: str
+    :type profiles: np.ndarray (modes, 12)
+    :type labels: sequence of str, one per mode
+    """
+    profiles = np.asarray(profiles, dtype='<f4')
+    if profiles.ndim != 2 or profiles.shape[1] != 12 or len(labels) != len(profiles):
+        raise ValueError("Expected one label and 12 values per mode")
+    with open(filename, 'wb') as f:
+        f.write(b'EDMP' + struct.pack('<II', 1, len(profiles)))
+        for label, profile in zip(labels, profiles):
+            label = label.encode('utf-8')
+            f.write(struct.pack('<I', len(label)) + label + profile.tobytes())
+
+
+def read_profile_file(filename):
+    """
+    Reads a key profile file written by write_profile_file().
+    Returns the labels and a (modes, 12) array of profiles.
+    :type filename: str
+    """
+    with open(filename, 'rb') as f:
+        data = f.read()
+    if len(data) < 12 or data[:4] != b'EDMP' or struct.unpack('<I', data[4:8])[0] != 1:
+        raise IOError("Not a key profile file: {0}".format(filename))
+    n_modes = struct.unpack('<I', data[8:12])[0]
+    labels, profiles, offset = [], [], 12
+    for _ in range(n_modes):
+        if offset + 4 > len(data):
+            raise IOError("Truncated key profile file: {0}".format(filename))
+        length = struct.unpack('<I', data[offset:offset + 4])[0]
+        if offset + 4 + length + 48 > len(data):
+            raise IOError("Truncated key profile file: {0}".format(filename))
+        labels.append(data[offset + 4:offset + 4 + length].decode('utf-8'))
+        offset += 4 + length
+        profiles.append(np.frombuffer(data[offset:offset + 48], dtype='<f4'))
+        offset += 48
+    if offset != len(data):
+        raise IOError("Unexpected data at the end of {0}".format(filename))
+    return labels, np.array(profiles)